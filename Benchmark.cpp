@@ -0,0 +1,725 @@
+#include "sources/BatchedIngestor.hpp"
+#include "sources/ConcurrentMagicalContainer.hpp"
+#include "sources/DurableMagicalContainer.hpp"
+#include "sources/EytzingerIndex.hpp"
+#include "sources/ExternalMagicalBuilder.hpp"
+#include "sources/LearnedIndex.hpp"
+#include "sources/PagedMagicalContainer.hpp"
+#include "sources/PersistentMagicalContainer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#if __has_include(<execution>)
+#include <execution>
+#endif
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ariel;
+using Clock = std::chrono::steady_clock;
+
+static double nanosPer(Clock::time_point start, std::size_t operations) {
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    return elapsed.count() / static_cast<double>(operations);
+}
+
+// Eytzinger index vs std::lower_bound, from L1-resident to larger than LLC
+static void benchSearch() {
+    std::cout << "search: elements  lower_bound(ns)  eytzinger(ns)\n";
+    std::mt19937 rng(42);
+    std::vector<int> queries(1 << 20);
+    for (std::size_t n : {std::size_t{1} << 10, std::size_t{1} << 14, std::size_t{1} << 18,
+                          std::size_t{1} << 22, std::size_t{1} << 24}) {
+        std::vector<int> sorted(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            sorted[i] = static_cast<int>(2 * i);
+        }
+        EytzingerIndex index;
+        index.build(sorted);
+        std::uniform_int_distribution<int> pick(0, static_cast<int>(2 * n));
+        for (int &query : queries) {
+            query = pick(rng);
+        }
+
+        std::size_t sink = 0;
+        auto start = Clock::now();
+        for (int query : queries) {
+            sink += static_cast<std::size_t>(std::lower_bound(sorted.begin(), sorted.end(), query) -
+                                             sorted.begin());
+        }
+        double binary = nanosPer(start, queries.size());
+
+        start = Clock::now();
+        for (int query : queries) {
+            sink -= index.lowerBound(query);
+        }
+        double eytzinger = nanosPer(start, queries.size());
+
+        std::cout << "        " << n << "  " << binary << "  " << eytzinger
+                  << (sink == 0 ? "" : "  (mismatch)") << '\n';
+    }
+}
+
+// Learned piecewise-linear model vs binary search on uniform random values
+static void benchLearned() {
+    std::cout << "learned: elements  segments  lower_bound(ns)  learned(ns)\n";
+    std::mt19937 rng(7);
+    std::vector<int> queries(1 << 20);
+    for (std::size_t n : {std::size_t{1} << 14, std::size_t{1} << 20, std::size_t{1} << 24}) {
+        std::vector<int> sorted(n);
+        for (int &value : sorted) {
+            value = static_cast<int>(rng() >> 1);
+        }
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+        LearnedIndex index(32);
+        index.build(sorted);
+        for (int &query : queries) {
+            query = static_cast<int>(rng() >> 1);
+        }
+
+        std::size_t sink = 0;
+        auto start = Clock::now();
+        for (int query : queries) {
+            sink += static_cast<std::size_t>(std::lower_bound(sorted.begin(), sorted.end(), query) -
+                                             sorted.begin());
+        }
+        double binary = nanosPer(start, queries.size());
+
+        start = Clock::now();
+        for (int query : queries) {
+            sink -= index.lowerBound(sorted, query);
+        }
+        double learned = nanosPer(start, queries.size());
+
+        std::cout << "        " << sorted.size() << "  " << index.segmentCount() << "  " << binary
+                  << "  " << learned << (sink == 0 ? "" : "  (mismatch)") << '\n';
+    }
+}
+
+// Single-element adds with the search index, then the learned index: the
+// lookup inside each add must not rebuild a stale index
+static void benchMutate() {
+    std::cout << "mutate: elements  add eytzinger(us)  add learned(us)\n";
+    for (int n : {10000, 30000, 60000}) {
+        std::cout << "        " << n;
+        for (bool learned : {false, true}) {
+            MagicalContainer container;
+            if (learned) {
+                container.enableLearnedIndex();
+            }
+            auto start = Clock::now();
+            for (int i = 0; i < n; ++i) {
+                container.addElement(i);
+            }
+            std::cout << "  " << nanosPer(start, static_cast<std::size_t>(n)) / 1000;
+        }
+        std::cout << '\n';
+    }
+}
+
+// Read throughput of ConcurrentMagicalContainer with 1..64 reader threads
+// while one writer keeps publishing versions: contains() through a pinned
+// ReadGuard vs the seqlock path
+static void benchConcurrentReaders() {
+    std::cout << "concurrent: readers  guard reads/ms  seqlock reads/ms\n";
+    MagicalContainer initial;
+    for (int i = 0; i < 20000; ++i) {
+        initial.addElement(i * 3);
+    }
+    ConcurrentMagicalContainer container(initial);
+    int next = 60000;
+
+    auto run = [&](unsigned threads, bool optimistic) {
+        std::atomic<bool> stop{false};
+        std::atomic<std::size_t> reads{0};
+        std::atomic<std::size_t> found{0};
+        std::vector<std::thread> pool;
+        for (unsigned t = 0; t < threads; ++t) {
+            pool.emplace_back([&, t] {
+                std::mt19937 rng(t);
+                std::size_t local = 0;
+                std::size_t hits = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    int value = static_cast<int>(rng() % 60000);
+                    bool hit = optimistic ? container.contains(value)
+                                          : container.read()->contains(value);
+                    hits += hit ? 1U : 0U;
+                    ++local;
+                }
+                reads += local;
+                found += hits;
+            });
+        }
+        auto start = Clock::now();
+        while (Clock::now() - start < std::chrono::milliseconds(200)) {
+            container.addElement(next++);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        stop = true;
+        for (std::thread &reader : pool) {
+            reader.join();
+        }
+        std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+        return static_cast<double>(reads.load()) / elapsed.count();
+    };
+
+    for (unsigned threads : {1U, 2U, 4U, 8U, 16U, 32U, 64U}) {
+        double guarded = run(threads, false);
+        double optimistic = run(threads, true);
+        std::cout << "        " << threads << "  " << guarded << "  " << optimistic << '\n';
+    }
+}
+
+// Bulk load speedup curve against a single-threaded build
+static void benchBuildParallel() {
+    std::cout << "build: threads  ms  speedup\n";
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> pick(0, 1 << 24);
+    std::vector<int> values(std::size_t{1} << 22);
+    for (int &value : values) {
+        value = pick(rng);
+    }
+    double single = 0;
+    for (unsigned threads : {1U, 2U, 4U, 8U, 16U, 32U}) {
+        auto start = Clock::now();
+        MagicalContainer built = MagicalContainer::buildParallel(values, threads);
+        double millis = nanosPer(start, 1000000);
+        if (threads == 1) {
+            single = millis;
+        }
+        std::cout << "        " << threads << "  " << millis << "  " << single / millis
+                  << (built.size() > 0 ? "" : "  (empty)") << '\n';
+    }
+}
+
+// Standard algorithms straight over the iterator ranges, serial against the
+// parallel execution policies (TBB-backed in libstdc++ when linked)
+static void benchStdAlgorithms() {
+    std::vector<int> values(std::size_t{1} << 22);
+    std::iota(values.begin(), values.end(), 0);
+    MagicalContainer container = MagicalContainer::buildParallel(values);
+    MagicalContainer::AscendingIterator ascending(container);
+    MagicalContainer::PrimeIterator primes(container);
+    auto square = [](int element) { return 1.0 * element * element; };
+
+    auto time = [](const char *name, auto run) {
+        auto start = Clock::now();
+        double result = run();
+        std::cout << "        " << name << "  " << nanosPer(start, 1000000) << " ms"
+                  << (result != 0 ? "" : "  (zero)") << '\n';
+    };
+    std::cout << "std: algorithm  time\n";
+    time("reduce serial", [&] {
+        return static_cast<double>(std::reduce(ascending.begin(), ascending.end(), 0LL));
+    });
+    time("transform_reduce serial", [&] {
+        return std::transform_reduce(primes.begin(), primes.end(), 0.0, std::plus<>(), square);
+    });
+#if defined(__cpp_lib_execution)
+    time("reduce par", [&] {
+        return static_cast<double>(
+            std::reduce(std::execution::par, ascending.begin(), ascending.end(), 0LL));
+    });
+    time("transform_reduce par_unseq", [&] {
+        return std::transform_reduce(std::execution::par_unseq, primes.begin(), primes.end(),
+                                     0.0, std::plus<>(), square);
+    });
+    time("for_each par_unseq", [&] {
+        std::atomic<long long> odd{0};
+        std::for_each(std::execution::par_unseq, ascending.begin(), ascending.end(),
+                      [&odd](int element) {
+                          if (element % 2 == 1) {
+                              odd.fetch_add(1, std::memory_order_relaxed);
+                          }
+                      });
+        return static_cast<double>(odd.load());
+    });
+#else
+    std::cout << "        (no <execution>; parallel policies skipped)\n";
+#endif
+}
+
+// Producers calling addElement directly vs through the batched ingestor
+static void benchIngest() {
+    std::cout << "ingest: producers  direct(ns/add)  batched(ns/add)\n";
+    const int perProducer = 5000;
+    for (int producers : {1, 2, 4, 8}) {
+        auto run = [&](auto add) {
+            std::vector<std::thread> threads;
+            auto start = Clock::now();
+            for (int p = 0; p < producers; ++p) {
+                threads.emplace_back([&add, p, producers] {
+                    for (int i = 0; i < perProducer; ++i) {
+                        add(i * producers + p);
+                    }
+                });
+            }
+            for (std::thread &thread : threads) {
+                thread.join();
+            }
+            return start;
+        };
+        const std::size_t total = static_cast<std::size_t>(producers * perProducer);
+
+        ConcurrentMagicalContainer direct;
+        double directNs =
+            nanosPer(run([&direct](int value) { direct.addElement(value); }), total);
+
+        ConcurrentMagicalContainer batched;
+        BatchedIngestor ingestor(batched);
+        auto start = run([&ingestor](int value) { ingestor.add(value); });
+        ingestor.flush();
+        double batchedNs = nanosPer(start, total);
+
+        std::cout << "        " << producers << "  " << directNs << "  " << batchedNs
+                  << (batched.size() == direct.size() ? "" : "  (mismatch)") << '\n';
+    }
+}
+
+// How long a rebuild blocks its caller done inline vs in the background, and
+// the slowest write that raced the background rebuild
+static void benchRebuild() {
+    std::cout << "rebuild: mode  caller blocked(ms)  slowest racing add(us)\n";
+    std::mt19937 rng(42);
+    std::vector<int> values(std::size_t{1} << 21);
+    for (int &value : values) {
+        value = static_cast<int>(rng() >> 1);
+    }
+
+    auto start = Clock::now();
+    MagicalContainer inline_ = MagicalContainer::buildParallel(values);
+    inline_.prepareLookups();
+    std::cout << "        inline  " << nanosPer(start, 1000000) << "  -\n";
+
+    ConcurrentMagicalContainer container;
+    std::atomic<bool> done{false};
+    double slowest = 0;
+    start = Clock::now();
+    std::future<void> rebuilt = container.rebuildAsync(values);
+    double blocked = nanosPer(start, 1000000);
+    std::thread writer([&] {
+        for (int i = 0; !done.load(); ++i) {
+            auto added = Clock::now();
+            container.addElement(-1 - i % 1000);
+            slowest = std::max(slowest, nanosPer(added, 1000));
+        }
+    });
+    rebuilt.get();
+    done = true;
+    writer.join();
+    std::cout << "        background  " << blocked << "  " << slowest
+              << (container.contains(-1) ? "" : "  (lost write)") << '\n';
+}
+
+// Side cross traversal against reading the vector directly. The difference
+// includes the debug generation check in operator* and operator++; build with
+// BENCH_DEFINES=-DNDEBUG (after make clean) to see it compiled out.
+static void benchGeneration() {
+#ifdef NDEBUG
+    std::cout << "generation: elements  vector(ns)  side cross(ns)  [checks off]\n";
+#else
+    std::cout << "generation: elements  vector(ns)  side cross(ns)  [checks on]\n";
+#endif
+    std::vector<int> values(std::size_t{1} << 20);
+    std::iota(values.begin(), values.end(), 0);
+    MagicalContainer container = MagicalContainer::buildParallel(values);
+    const std::size_t n = values.size();
+    constexpr int rounds = 20;
+
+    long long sum = 0;
+    auto start = Clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        for (std::size_t i = 0; i < n; ++i) {
+            sum += values[i % 2 == 0 ? i / 2 : n - 1 - i / 2];
+        }
+    }
+    double direct = nanosPer(start, rounds * n);
+
+    long long crossSum = 0;
+    start = Clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        MagicalContainer::SideCrossIterator it(container);
+        for (MagicalContainer::SideCrossIterator end = it.end(); it != end; ++it) {
+            crossSum += *it;
+        }
+    }
+    double cross = nanosPer(start, rounds * n);
+    std::cout << "        " << n << "  " << direct << "  " << cross
+              << (sum == crossSum ? "" : "  (mismatch)") << '\n';
+}
+
+// Taking a point-in-time view vs copying the container, and what a live view
+// costs the writer: the first write after a view copies the chunk table and
+// one chunk
+static void benchSnapshot() {
+    std::cout << "snapshot: elements  copy(us)  view(us)  add(us)  add with view(us)\n";
+    for (std::size_t n : {std::size_t{1} << 16, std::size_t{1} << 20}) {
+        std::vector<int> values(n);
+        std::iota(values.begin(), values.end(), 0);
+        MagicalContainer container = MagicalContainer::buildParallel(values);
+        container.snapshot(); // builds the mirror once
+
+        auto start = Clock::now();
+        MagicalContainer copy(container);
+        double copied = nanosPer(start, 1000);
+
+        start = Clock::now();
+        SnapshotView view = container.snapshot();
+        double viewed = nanosPer(start, 1000);
+
+        constexpr int adds = 200;
+        start = Clock::now();
+        for (int i = 0; i < adds; ++i) {
+            container.addElement(-1 - i);
+        }
+        double plain = nanosPer(start, adds * 1000);
+
+        start = Clock::now();
+        for (int i = 0; i < adds; ++i) {
+            SnapshotView held = container.snapshot();
+            container.addElement(-1001 - i);
+        }
+        double shared = nanosPer(start, adds * 1000);
+        std::cout << "        " << n << "  " << copied << "  " << viewed << "  " << plain
+                  << "  " << shared << (view.size() + adds * 2 == container.size() ? "" : "  (mismatch)")
+                  << '\n';
+    }
+}
+
+// Cost of a new version per mutation, and of reading an old one back
+static void benchPersistent() {
+    std::cout << "persistent: elements  add(ns)  remove(ns)  old version scan(ns/element)\n";
+    std::mt19937 rng(42);
+    for (std::size_t n : {std::size_t{1} << 14, std::size_t{1} << 18}) {
+        std::vector<int> values(n);
+        std::iota(values.begin(), values.end(), 0);
+        std::shuffle(values.begin(), values.end(), rng);
+        PersistentMagicalContainer container(n);
+        auto start = Clock::now();
+        for (int value : values) {
+            container.addElement(value);
+        }
+        double added = nanosPer(start, n);
+
+        PersistentMagicalContainer::Version full = container.versionsAgo(0);
+        start = Clock::now();
+        for (std::size_t i = 0; i < n / 2; ++i) {
+            container.removeElement(values[i]);
+        }
+        double removed = nanosPer(start, n / 2);
+
+        long long sum = 0;
+        start = Clock::now();
+        for (int element : PersistentMagicalContainer::AscendingIterator(full)) {
+            sum += element;
+        }
+        double scanned = nanosPer(start, static_cast<std::size_t>(full.size()));
+        std::cout << "        " << n << "  " << added << "  " << removed << "  " << scanned
+                  << (sum == 0 ? "  (empty)" : "") << '\n';
+    }
+}
+
+// Startup from a snapshot file: rebuilding from the values vs mapping the file
+static void benchMapLoad() {
+    std::cout << "mapload: elements  save(ms)  rebuild(ms)  map(ms)  first scan(ms)\n";
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "magical_bench_snapshot.bin").string();
+    std::vector<int> values(std::size_t{1} << 22);
+    std::iota(values.begin(), values.end(), 0);
+    MagicalContainer container = MagicalContainer::buildParallel(values);
+
+    auto start = Clock::now();
+    container.save(path);
+    double saved = nanosPer(start, 1000000);
+
+    start = Clock::now();
+    MagicalContainer rebuilt = MagicalContainer::buildParallel(values);
+    double rebuilding = nanosPer(start, 1000000);
+
+    start = Clock::now();
+    MappedMagicalContainer mapped = MagicalContainer::mapFromFile(path);
+    double mapping = nanosPer(start, 1000000);
+
+    long long sum = 0;
+    start = Clock::now();
+    for (int element : MappedMagicalContainer::AscendingIterator(mapped)) {
+        sum += element;
+    }
+    double scanned = nanosPer(start, 1000000);
+    std::cout << "        " << mapped.size() << "  " << saved << "  " << rebuilding << "  "
+              << mapping << "  " << scanned << (sum > 0 && rebuilt.size() == mapped.size() ? "" : "  (mismatch)")
+              << '\n';
+    std::remove(path.c_str());
+}
+
+// Adds through the write-ahead log against plain in-memory adds. With
+// waitForSync every add waits for its group commit; writers running at the
+// same time share one fdatasync.
+static void benchWal() {
+    std::cout << "wal: writers  memory(ns/add)  no wait(ns/add)  wait(ns/add)  syncs\n";
+    const std::string directory =
+        (std::filesystem::temp_directory_path() / "magical_bench_wal").string();
+    constexpr int perWriter = 2000;
+    for (int writers : {1, 4}) {
+        const auto total = static_cast<std::size_t>(writers * perWriter);
+        std::mutex memoryMutex;
+        MagicalContainer memory;
+        auto run = [&](auto add) {
+            std::vector<std::thread> threads;
+            auto start = Clock::now();
+            for (int t = 0; t < writers; ++t) {
+                threads.emplace_back([&add, t] {
+                    for (int i = 0; i < perWriter; ++i) {
+                        add(t * perWriter + i);
+                    }
+                });
+            }
+            for (std::thread &thread : threads) {
+                thread.join();
+            }
+            return nanosPer(start, total);
+        };
+        double inMemory = run([&](int element) {
+            std::lock_guard<std::mutex> lock(memoryMutex);
+            memory.addElement(element);
+        });
+
+        double noWait = 0;
+        double wait = 0;
+        std::size_t syncs = 0;
+        for (bool waitForSync : {false, true}) {
+            std::filesystem::remove_all(directory);
+            DurableMagicalContainer durable(directory, waitForSync);
+            double took = run([&](int element) { durable.addElement(element); });
+            durable.sync();
+            (waitForSync ? wait : noWait) = took;
+            syncs = durable.syncCount();
+        }
+        std::cout << "        " << writers << "  " << inMemory << "  " << noWait << "  " << wait
+                  << "  " << syncs << '\n';
+    }
+    std::filesystem::remove_all(directory);
+}
+
+// Text loading: iostream extraction vs loadText, both inserting through
+// buildParallel, in MB of input per second
+static void benchLoadText() {
+    std::cout << "loadtext: MB  iostream(MB/s)  loadText(MB/s)\n";
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "magical_bench_load.txt").string();
+    std::mt19937 rng(42);
+    std::string text;
+    while (text.size() < (std::size_t{128} << 20)) {
+        text += std::to_string(static_cast<int>(rng() >> 12));
+        text += '\n';
+    }
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << text;
+    }
+    const double megabytes = static_cast<double>(text.size()) / (1 << 20);
+
+    auto start = Clock::now();
+    std::vector<int> values;
+    {
+        std::ifstream file(path);
+        int value = 0;
+        while (file >> value) {
+            values.push_back(value);
+        }
+    }
+    MagicalContainer streamed = MagicalContainer::buildParallel(values);
+    double iostream = megabytes / (nanosPer(start, 1) / 1e9);
+
+    start = Clock::now();
+    MagicalContainer loaded = MagicalContainer::loadText(path);
+    double fast = megabytes / (nanosPer(start, 1) / 1e9);
+    std::cout << "        " << static_cast<int>(megabytes) << "  " << iostream << "  " << fast
+              << (loaded.size() == streamed.size() ? "" : "  (mismatch)") << '\n';
+    std::remove(path.c_str());
+}
+
+// Dumping each order as text: dereferencing iterators into an ofstream vs
+// exportTo, in ms for 4M elements
+static void benchExport() {
+    std::cout << "export: order  ofstream(ms)  exportTo text(ms)  exportTo binary(ms)\n";
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "magical_bench_export").string();
+    std::vector<int> values(std::size_t{1} << 22);
+    std::iota(values.begin(), values.end(), 0);
+    MagicalContainer container = MagicalContainer::buildParallel(values);
+
+    auto viaStream = [&](auto it) {
+        auto start = Clock::now();
+        std::ofstream file(path);
+        for (; it != it.end(); ++it) {
+            file << *it << '\n';
+        }
+        file.close();
+        return nanosPer(start, 1000000);
+    };
+    auto viaExport = [&](TraversalOrder order, ExportFormat format) {
+        auto start = Clock::now();
+        container.exportTo(path, order, format);
+        return nanosPer(start, 1000000);
+    };
+    std::cout << "        ascending  " << viaStream(MagicalContainer::AscendingIterator(container))
+              << "  " << viaExport(TraversalOrder::Ascending, ExportFormat::Text) << "  "
+              << viaExport(TraversalOrder::Ascending, ExportFormat::Binary) << '\n';
+    std::cout << "        side cross  " << viaStream(MagicalContainer::SideCrossIterator(container))
+              << "  " << viaExport(TraversalOrder::SideCross, ExportFormat::Text) << "  "
+              << viaExport(TraversalOrder::SideCross, ExportFormat::Binary) << '\n';
+    std::cout << "        prime  " << viaStream(MagicalContainer::PrimeIterator(container)) << "  "
+              << viaExport(TraversalOrder::Prime, ExportFormat::Text) << "  "
+              << viaExport(TraversalOrder::Prime, ExportFormat::Binary) << '\n';
+    std::remove(path.c_str());
+}
+
+// Out-of-core build at several memory budgets against an in-memory build and
+// save; a smaller budget means more runs and, below the fan-in, merge passes
+static void benchExternal() {
+    std::cout << "external: elements  budget(MiB)  runs  build(ms)  in-memory build+save(ms)\n";
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "magical_bench_external.bin").string();
+    std::mt19937 rng(49);
+    std::vector<int> values(std::size_t{1} << 22);
+    for (int &value : values) {
+        value = static_cast<int>(rng() >> 8); // isPrime stays cheap next to the sort
+    }
+
+    auto start = Clock::now();
+    MagicalContainer::buildParallel(values).save(path);
+    double inMemory = nanosPer(start, 1000000);
+
+    for (std::size_t budget : {std::size_t{1} << 20, std::size_t{8} << 20, std::size_t{64} << 20}) {
+        start = Clock::now();
+        ExternalMagicalBuilder builder(path, budget);
+        builder.add(values);
+        MappedMagicalContainer mapped = builder.finish();
+        double external = nanosPer(start, 1000000);
+        std::cout << "        " << mapped.size() << "  " << (budget >> 20) << "  "
+                  << builder.runCount() << "  " << external << "  " << inMemory << '\n';
+    }
+    std::remove(path.c_str());
+}
+
+// Scans and searches through the paged buffer pool at several pool sizes,
+// against the mapped file; the pool reads with pread, the mapping faults
+static void benchPaged() {
+    std::cout << "paged: pool pages  ascending(ns/elem)  side cross(ns/elem)  search(ns)  "
+                 "hit rate  evictions\n";
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "magical_bench_paged.bin").string();
+    std::vector<int> values(std::size_t{1} << 22);
+    std::iota(values.begin(), values.end(), 0);
+    MagicalContainer::buildParallel(values).save(path);
+
+    std::mt19937 rng(50);
+    std::vector<int> queries(1 << 18);
+    for (int &query : queries) {
+        query = static_cast<int>(rng() % values.size());
+    }
+    auto measure = [&](const auto &container, auto ascending, auto cross) {
+        long long sum = 0;
+        auto start = Clock::now();
+        for (int element : ascending) {
+            sum += element;
+        }
+        double scanned = nanosPer(start, values.size());
+        start = Clock::now();
+        for (int element : cross) {
+            sum += element;
+        }
+        double crossed = nanosPer(start, values.size());
+        start = Clock::now();
+        std::size_t found = 0;
+        for (int query : queries) {
+            found += container.contains(query) ? 1u : 0u;
+        }
+        double searched = nanosPer(start, queries.size());
+        std::cout << scanned << "  " << crossed << "  " << searched
+                  << (sum > 0 && found == queries.size() ? "" : "  (mismatch)");
+    };
+
+    for (std::size_t pages : {std::size_t{16}, std::size_t{256}, std::size_t{4096}}) {
+        PagedMagicalContainer paged(path, pages);
+        std::cout << "        " << pages << "  ";
+        paged.resetMetrics();
+        measure(paged, PagedMagicalContainer::AscendingIterator(paged),
+                PagedMagicalContainer::SideCrossIterator(paged));
+        PagedMagicalContainer::Metrics metrics = paged.metrics();
+        std::cout << "  " << metrics.hitRate() << "  " << metrics.evictions << '\n';
+    }
+    MappedMagicalContainer mapped(path);
+    std::cout << "        mapped  ";
+    measure(mapped, MappedMagicalContainer::AscendingIterator(mapped),
+            MappedMagicalContainer::SideCrossIterator(mapped));
+    std::cout << '\n';
+    std::remove(path.c_str());
+}
+
+int main(int argc, char **argv) {
+    std::string only = argc > 1 ? argv[1] : "";
+    if (only.empty() || only == "search") {
+        benchSearch();
+    }
+    if (only.empty() || only == "learned") {
+        benchLearned();
+    }
+    if (only.empty() || only == "mutate") {
+        benchMutate();
+    }
+    if (only.empty() || only == "concurrent") {
+        benchConcurrentReaders();
+    }
+    if (only.empty() || only == "build") {
+        benchBuildParallel();
+    }
+    if (only.empty() || only == "std") {
+        benchStdAlgorithms();
+    }
+    if (only.empty() || only == "ingest") {
+        benchIngest();
+    }
+    if (only.empty() || only == "rebuild") {
+        benchRebuild();
+    }
+    if (only.empty() || only == "generation") {
+        benchGeneration();
+    }
+    if (only.empty() || only == "snapshot") {
+        benchSnapshot();
+    }
+    if (only.empty() || only == "persistent") {
+        benchPersistent();
+    }
+    if (only.empty() || only == "mapload") {
+        benchMapLoad();
+    }
+    if (only.empty() || only == "wal") {
+        benchWal();
+    }
+    if (only.empty() || only == "loadtext") {
+        benchLoadText();
+    }
+    if (only.empty() || only == "export") {
+        benchExport();
+    }
+    if (only.empty() || only == "external") {
+        benchExternal();
+    }
+    if (only.empty() || only == "paged") {
+        benchPaged();
+    }
+    return 0;
+}
@@ -1,6 +1,31 @@
 #include "doctest.h"
 #include "sources/MagicalContainer.hpp"
+#include "sources/AsyncMutationQueue.hpp"
+#include "sources/BatchedIngestor.hpp"
+#include "sources/ConcurrentMagicalContainer.hpp"
+#include "sources/DurableMagicalContainer.hpp"
+#include "sources/EytzingerIndex.hpp"
+#include "sources/ExternalMagicalBuilder.hpp"
+#include "sources/FrozenMagicalContainer.hpp"
+#include "sources/LearnedIndex.hpp"
+#include "sources/MappedMagicalContainer.hpp"
+#include "sources/PagedMagicalContainer.hpp"
+#include "sources/ParallelForEach.hpp"
+#include "sources/PersistentMagicalContainer.hpp"
+#include "sources/RoaringBitmap.hpp"
+#include "sources/ShardedMagicalContainer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
 #include <stdexcept>
+#include <sys/resource.h>
+#include <thread>
 
 using namespace ariel;
 using namespace std;
@@ -596,3 +621,1750 @@ TEST_CASE("operator= throws when iterators are pointing at different containers"
    }
 }
 
+
+// Test case for the compressed bitmap backend
+TEST_CASE("RoaringBitmap") {
+    RoaringBitmap bitmap;
+    MagicalContainer container;
+    for (int i = -50; i < 5000; i += 3) {
+        bitmap.addElement(i);
+        container.addElement(i);
+    }
+    bitmap.addElement(7);
+    container.addElement(7);
+
+    SUBCASE("Matches MagicalContainer traversal") {
+        CHECK(bitmap.size() == container.size());
+        std::vector<int> ascending;
+        bitmap.forEachAscending([&](int value) { ascending.push_back(value); });
+        std::vector<int> expected;
+        MagicalContainer::AscendingIterator it(container);
+        for (auto i = it.begin(); i != it.end(); ++i) {
+            expected.push_back(*i);
+        }
+        CHECK(ascending == expected);
+
+        std::vector<int> primes;
+        bitmap.forEachPrime([&](int value) { primes.push_back(value); });
+        std::vector<int> expectedPrimes;
+        MagicalContainer::PrimeIterator pit(container);
+        for (auto i = pit.begin(); i != pit.end(); ++i) {
+            expectedPrimes.push_back(*i);
+        }
+        CHECK(primes == expectedPrimes);
+    }
+
+    SUBCASE("Removing elements") {
+        CHECK(bitmap.contains(7));
+        bitmap.removeElement(7);
+        CHECK_FALSE(bitmap.contains(7));
+        CHECK_THROWS_AS(bitmap.removeElement(7), runtime_error);
+    }
+
+    SUBCASE("Dense sets use under one byte per element") {
+        RoaringBitmap dense;
+        for (int i = 0; i < 200000; ++i) {
+            dense.addElement(i);
+        }
+        CHECK(dense.memoryUsage() < 200000);
+        dense.runOptimize();
+        CHECK(dense.memoryUsage() < 2000);
+        CHECK(dense.contains(131071));
+        dense.removeElement(131071);
+        CHECK(dense.size() == 199999);
+        CHECK_FALSE(dense.contains(131071));
+
+        // Bitmap chunks at the bottom of the range and at the very top
+        for (long long i = 2147418112; i <= 2147483647; ++i) {
+            dense.addElement(static_cast<int>(i));
+        }
+        std::vector<int> primes;
+        dense.forEachPrime([&](int value) { primes.push_back(value); });
+        std::vector<int> expected;
+        dense.forEachAscending([&](int value) {
+            if (isPrime(value)) {
+                expected.push_back(value);
+            }
+        });
+        CHECK(primes == expected);
+        CHECK(primes.front() == 2);
+        CHECK(primes.back() == 2147483647);
+    }
+
+    SUBCASE("Sparse chunks and chunks past the mask cache") {
+        RoaringBitmap spread;
+        for (int chunk = 0; chunk < 300; ++chunk) {
+            // Chunks below 100 stay small enough to test value by value
+            int perChunk = chunk < 100 ? 5 : 40;
+            for (int i = 0; i < perChunk; ++i) {
+                spread.addElement(chunk * 65536 + i * 97 + 1);
+            }
+        }
+        std::vector<int> primes;
+        spread.forEachPrime([&](int value) { primes.push_back(value); });
+        std::vector<int> expected;
+        spread.forEachAscending([&](int value) {
+            if (isPrime(value)) {
+                expected.push_back(value);
+            }
+        });
+        CHECK(primes == expected);
+        CHECK(primes.size() > 100);
+    }
+}
+
+// Test case for the frozen compressed snapshot
+TEST_CASE("Frozen CompressedSnapshot") {
+    MagicalContainer container;
+    for (int i = 0; i < 700; ++i) {
+        container.addElement(i * i - 5000);
+    }
+    container.addElement(2147483647);
+    container.addElement(-2147483647 - 1);
+    CompressedSnapshot frozen = container.freeze();
+
+    SUBCASE("Ascending order survives compression") {
+        CHECK(frozen.size() == container.size());
+        MagicalContainer::AscendingIterator expected(container);
+        CompressedSnapshot::AscendingIterator it(frozen);
+        auto want = expected.begin();
+        for (auto got = it.begin(); got != it.end(); ++got, ++want) {
+            CHECK(*got == *want);
+        }
+        CHECK(want == expected.end());
+    }
+
+    SUBCASE("Prime order survives compression") {
+        MagicalContainer::PrimeIterator expected(container);
+        CompressedSnapshot::PrimeIterator it(frozen);
+        auto want = expected.begin();
+        for (auto got = it.begin(); got != it.end(); ++got, ++want) {
+            CHECK(*got == *want);
+        }
+        CHECK(want == expected.end());
+        CHECK_THROWS_AS(++it.end(), runtime_error);
+    }
+
+    SUBCASE("Primes come from the container after removals") {
+        container.removeElement(2147483647);
+        container.addElement(7919);
+        CompressedSnapshot refrozen = container.freeze();
+        MagicalContainer::PrimeIterator expected(container);
+        CompressedSnapshot::PrimeIterator it(refrozen);
+        auto want = expected.begin();
+        int count = 0;
+        for (auto got = it.begin(); got != it.end(); ++got, ++want, ++count) {
+            CHECK(*got == *want);
+        }
+        CHECK(want == expected.end());
+        CHECK(refrozen.primes() == count);
+    }
+
+    SUBCASE("Seeking through the skip index") {
+        CHECK(frozen.contains(2147483647));
+        CHECK(frozen.contains(100 * 100 - 5000));
+        CHECK_FALSE(frozen.contains(100 * 100 - 4999));
+        CHECK(frozen.lowerBound(-5000) == 1);
+        CHECK(frozen.memoryUsage() < 702 * sizeof(int));
+    }
+}
+
+// Test case for the read-only frozen container
+TEST_CASE("FrozenMagicalContainer") {
+    MagicalContainer container;
+    for (int i = 1; i <= 2000; i += 3) {
+        container.addElement(i);
+    }
+    FrozenMagicalContainer frozen(container);
+
+    SUBCASE("Perfect hash membership") {
+        CHECK(frozen.size() == container.size());
+        for (int i = 1; i <= 2000; ++i) {
+            CHECK(frozen.contains(i) == (i % 3 == 1));
+        }
+        CHECK_FALSE(frozen.contains(-1));
+        CHECK(frozen.lowerBound(5) == 2);
+        CHECK(frozen.lowerBound(3000) == 667);
+    }
+
+    SUBCASE("Same traversal orders as the source") {
+        MagicalContainer::SideCrossIterator cross(container);
+        FrozenMagicalContainer::SideCrossIterator frozenCross(frozen);
+        auto want = cross.begin();
+        for (auto got = frozenCross.begin(); got != frozenCross.end(); ++got, ++want) {
+            CHECK(*got == *want);
+        }
+
+        MagicalContainer::PrimeIterator primes(container);
+        FrozenMagicalContainer::PrimeIterator frozenPrimes(frozen);
+        auto wantPrime = primes.begin();
+        for (auto got = frozenPrimes.begin(); got != frozenPrimes.end(); ++got, ++wantPrime) {
+            CHECK(*got == *wantPrime);
+        }
+        CHECK(wantPrime == primes.end());
+    }
+
+    SUBCASE("Large sets grow the table rather than search forever") {
+        // Too many keys for the last buckets to find a free slot of a
+        // minimal table within the attempt cap
+        std::vector<int> values;
+        for (int i = 1; i <= 600000; i += 2) {
+            values.push_back(i);
+        }
+        MagicalContainer large = MagicalContainer::buildParallel(values);
+        FrozenMagicalContainer frozenLarge(large);
+        bool allFound = true;
+        bool noneExtra = true;
+        for (int i = -2; i <= 600002; ++i) {
+            bool found = frozenLarge.contains(i);
+            allFound = allFound && (found || i % 2 == 0 || i < 0 || i > 600000);
+            noneExtra = noneExtra && (!found || (i > 0 && i % 2 == 1));
+        }
+        CHECK(allFound);
+        CHECK(noneExtra);
+    }
+
+    SUBCASE("Frozen from a const container") {
+        const MagicalContainer &source = container;
+        FrozenMagicalContainer copy(source);
+        CHECK(copy.size() == frozen.size());
+        CHECK(copy.contains(1999));
+        CHECK(*FrozenMagicalContainer::PrimeIterator(copy) == 7);
+    }
+
+    SUBCASE("Empty container") {
+        MagicalContainer empty;
+        FrozenMagicalContainer frozenEmpty(empty);
+        CHECK_FALSE(frozenEmpty.contains(0));
+        FrozenMagicalContainer::AscendingIterator it(frozenEmpty);
+        CHECK(it == it.end());
+    }
+}
+
+// Test case for the Eytzinger search index
+TEST_CASE("EytzingerIndex lookups") {
+    SUBCASE("Matches std::lower_bound") {
+        for (int n = 0; n < 70; ++n) {
+            std::vector<int> sorted;
+            for (int i = 0; i < n; ++i) {
+                sorted.push_back(i * 2);
+            }
+            EytzingerIndex index;
+            index.build(sorted);
+            for (int value = -1; value <= n * 2 + 1; ++value) {
+                auto expected = std::lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin();
+                CHECK(index.lowerBound(value) == static_cast<std::size_t>(expected));
+            }
+        }
+    }
+
+    SUBCASE("Container stays consistent through adds and removes") {
+        MagicalContainer container;
+        for (int i = 20; i > 0; --i) {
+            container.addElement(i);
+        }
+        container.addElement(7);
+        container.removeElement(7);
+        container.removeElement(1);
+        CHECK(container.size() == 18);
+        CHECK_THROWS_AS(container.removeElement(7), runtime_error);
+
+        std::vector<int> primes;
+        MagicalContainer::PrimeIterator it(container);
+        for (auto i = it.begin(); i != it.end(); ++i) {
+            primes.push_back(*i);
+        }
+        CHECK(primes == std::vector<int>{2, 3, 5, 11, 13, 17, 19});
+    }
+}
+
+// Test case for the learned lookup accelerator
+TEST_CASE("LearnedIndex lookups") {
+    std::mt19937 rng(7);
+    std::vector<int> sorted;
+    for (int i = 0; i < 5000; ++i) {
+        sorted.push_back(static_cast<int>(rng() % 1000000));
+    }
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    SUBCASE("Matches std::lower_bound") {
+        LearnedIndex index(8);
+        index.build(sorted);
+        CHECK(index.segmentCount() < sorted.size() / 8);
+        for (int value = -5; value < 1000005; value += 97) {
+            auto expected = std::lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin();
+            CHECK(index.lowerBound(sorted, value) == static_cast<std::size_t>(expected));
+        }
+    }
+
+    SUBCASE("Container lookups stay correct while the model is stale") {
+        MagicalContainer container;
+        container.enableLearnedIndex(4);
+        for (int value : sorted) {
+            container.addElement(value);
+        }
+        container.removeElement(sorted[10]);
+        CHECK_FALSE(container.contains(sorted[10]));
+        for (int i = 0; i < 40; ++i) {
+            CHECK(container.contains(sorted[static_cast<std::size_t>(i) * 100 + 11]));
+        }
+        CHECK_FALSE(container.contains(-1));
+        container.addElement(-1);
+        CHECK(container.contains(-1));
+    }
+}
+
+// Stress test: one writer publishing versions while readers iterate
+TEST_CASE("ConcurrentMagicalContainer readers and writer") {
+    ConcurrentMagicalContainer container;
+    std::atomic<bool> done{false};
+    std::atomic<int> badReads{0};
+    std::atomic<int> reads{0};
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.emplace_back([&] {
+            while (!done.load()) {
+                auto guard = container.read();
+                MagicalContainer::AscendingIterator it(*guard);
+                int previous = INT_MIN;
+                int seen = 0;
+                for (auto i = it.begin(); i != it.end(); ++i, ++seen) {
+                    if (*i <= previous) {
+                        ++badReads;
+                    }
+                    previous = *i;
+                }
+                if (seen != guard->size()) {
+                    ++badReads;
+                }
+                MagicalContainer::PrimeIterator primes(*guard);
+                for (auto i = primes.begin(); i != primes.end(); ++i) {
+                    if (!isPrime(*i)) {
+                        ++badReads;
+                    }
+                }
+                ++reads;
+            }
+        });
+    }
+
+    for (int i = 0; i < 300; ++i) {
+        container.addElement(i);
+        if (i % 4 == 0 && i > 0) {
+            container.removeElement(i - 1);
+        }
+    }
+    while (reads.load() < 8) {
+        std::this_thread::yield();
+    }
+    done = true;
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+
+    CHECK(badReads.load() == 0);
+    CHECK(container.size() == 226);
+    CHECK(container.contains(298));
+    CHECK_FALSE(container.contains(295));
+    CHECK_THROWS_AS(container.removeElement(295), runtime_error);
+    CHECK(container.retiredVersions() == 0);
+}
+
+TEST_CASE("ConcurrentMagicalContainer reader limit") {
+    ConcurrentMagicalContainer container;
+    container.addElement(5);
+    std::vector<ConcurrentMagicalContainer::ReadGuard> guards;
+    guards.reserve(ConcurrentMagicalContainer::MAX_READERS);
+    for (std::size_t i = 0; i < ConcurrentMagicalContainer::MAX_READERS; ++i) {
+        guards.push_back(container.read());
+    }
+    CHECK_THROWS_AS(container.read(), runtime_error);
+    guards.pop_back();
+    CHECK(container.read()->contains(5));
+}
+
+// Seqlock point reads racing a writer
+TEST_CASE("ConcurrentMagicalContainer optimistic reads") {
+    MagicalContainer initial;
+    for (int i = 0; i < 100; i += 2) {
+        initial.addElement(i);
+    }
+    ConcurrentMagicalContainer container(initial);
+
+    SUBCASE("Scan returns the next elements in order") {
+        int out[4] = {};
+        CHECK(container.scan(9, out, 4) == 4);
+        CHECK(out[0] == 10);
+        CHECK(out[3] == 16);
+        CHECK(container.scan(97, out, 4) == 1);
+        CHECK(out[0] == 98);
+        CHECK(container.size() == 50);
+    }
+
+    SUBCASE("Readers never see a torn state") {
+        std::atomic<bool> done{false};
+        std::atomic<int> badReads{0};
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 3; ++r) {
+            readers.emplace_back([&] {
+                int out[8];
+                while (!done.load()) {
+                    // Even values are never removed
+                    if (!container.contains(50)) {
+                        ++badReads;
+                    }
+                    std::size_t copied = container.scan(40, out, 8);
+                    for (std::size_t i = 1; i < copied; ++i) {
+                        if (out[i] <= out[i - 1]) {
+                            ++badReads;
+                        }
+                    }
+                }
+            });
+        }
+        for (int i = 1; i < 400; i += 2) {
+            container.addElement(i);
+        }
+        for (int i = 1; i < 400; i += 4) {
+            container.removeElement(i);
+        }
+        done = true;
+        for (std::thread &reader : readers) {
+            reader.join();
+        }
+        CHECK(badReads.load() == 0);
+        CHECK(container.size() == 150);
+        CHECK(container.contains(3));
+        CHECK_FALSE(container.contains(5));
+    }
+}
+
+// Value-range shards behave like one container
+TEST_CASE("ShardedMagicalContainer") {
+    ShardedMagicalContainer sharded(4, 0, 1000);
+    MagicalContainer plain;
+    for (int i = 997; i > 0; i -= 13) {
+        sharded.addElement(i);
+        plain.addElement(i);
+    }
+    sharded.addElement(997);
+    CHECK(sharded.size() == plain.size());
+    const ShardedMagicalContainer &reader = sharded;
+    CHECK(reader.contains(997));
+    CHECK_FALSE(reader.contains(998));
+    CHECK(reader.shardSize(0) + reader.shardSize(1) + reader.shardSize(2) +
+              reader.shardSize(3) == reader.size());
+
+    SUBCASE("Traversals match a plain container") {
+        std::vector<int> expected;
+        std::vector<int> actual;
+        MagicalContainer::AscendingIterator plainAscending(plain);
+        for (auto it = plainAscending.begin(); it != plainAscending.end(); ++it) {
+            expected.push_back(*it);
+        }
+        ShardedMagicalContainer::AscendingIterator ascending(sharded);
+        for (auto it = ascending.begin(); it != ascending.end(); ++it) {
+            actual.push_back(*it);
+        }
+        CHECK(actual == expected);
+
+        expected.clear();
+        actual.clear();
+        MagicalContainer::PrimeIterator plainPrime(plain);
+        for (auto it = plainPrime.begin(); it != plainPrime.end(); ++it) {
+            expected.push_back(*it);
+        }
+        ShardedMagicalContainer::PrimeIterator prime(sharded);
+        for (auto it = prime.begin(); it != prime.end(); ++it) {
+            actual.push_back(*it);
+        }
+        CHECK(actual == expected);
+
+        expected.clear();
+        actual.clear();
+        MagicalContainer::SideCrossIterator plainCross(plain);
+        for (auto it = plainCross.begin(); it != plainCross.end(); ++it) {
+            expected.push_back(*it);
+        }
+        ShardedMagicalContainer::SideCrossIterator cross(sharded);
+        for (auto it = cross.begin(); it != cross.end(); ++it) {
+            actual.push_back(*it);
+        }
+        CHECK(actual == expected);
+        CHECK_THROWS_AS(++cross.end(), runtime_error);
+    }
+
+    SUBCASE("Empty container") {
+        ShardedMagicalContainer empty(3);
+        ShardedMagicalContainer::AscendingIterator ascending(empty);
+        ShardedMagicalContainer::SideCrossIterator cross(empty);
+        ShardedMagicalContainer::PrimeIterator prime(empty);
+        CHECK(ascending.begin() == ascending.end());
+        CHECK(cross.begin() == cross.end());
+        CHECK(prime.begin() == prime.end());
+        CHECK_THROWS_AS(empty.removeElement(1), runtime_error);
+    }
+
+    SUBCASE("Writers on different shards") {
+        ShardedMagicalContainer shared(4, 0, 4000);
+        std::vector<std::thread> writers;
+        for (int w = 0; w < 4; ++w) {
+            writers.emplace_back([&shared, w] {
+                for (int i = w * 1000; i < w * 1000 + 200; ++i) {
+                    shared.addElement(i);
+                }
+            });
+        }
+        for (std::thread &writer : writers) {
+            writer.join();
+        }
+        CHECK(shared.size() == 800);
+        CHECK(shared.shardSize(2) == 200);
+        CHECK(shared.contains(3199));
+        CHECK_FALSE(shared.contains(3200));
+    }
+
+    SUBCASE("Skewed data moves the boundaries") {
+        ShardedMagicalContainer skewed(4, 0, 1 << 20);
+        for (int i = 0; i < 1100; ++i) {
+            skewed.addElement(i);
+        }
+        CHECK(skewed.size() == 1100);
+        int largest = 0;
+        for (std::size_t s = 0; s < skewed.shardCount(); ++s) {
+            largest = std::max(largest, skewed.shardSize(s));
+        }
+        CHECK(largest < 1100);
+        CHECK_FALSE(skewed.rebalance());
+        skewed.removeElement(0);
+        ShardedMagicalContainer::AscendingIterator it(skewed);
+        CHECK(*it.begin() == 1);
+
+        // Every value still routes to the shard that holds it
+        CHECK(skewed.rebalance(true));
+        int expected = 1;
+        for (int element : ShardedMagicalContainer::AscendingIterator(skewed)) {
+            CHECK(element == expected++);
+            CHECK(skewed.contains(element));
+        }
+        CHECK(expected == 1100);
+    }
+}
+
+// Parallel bulk load matches element-by-element insertion
+TEST_CASE("MagicalContainer::buildParallel") {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> pick(-50000, 50000);
+    std::vector<int> values(100000);
+    for (int &value : values) {
+        value = pick(rng);
+    }
+
+    std::vector<int> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    for (unsigned threads : {1U, 3U, 8U}) {
+        MagicalContainer built = MagicalContainer::buildParallel(values, threads);
+        CHECK(built.size() == static_cast<int>(sorted.size()));
+
+        std::vector<int> ascending;
+        MagicalContainer::AscendingIterator it(built);
+        for (auto i = it.begin(); i != it.end(); ++i) {
+            ascending.push_back(*i);
+        }
+        CHECK(ascending == sorted);
+
+        std::vector<int> primes;
+        MagicalContainer::PrimeIterator prime(built);
+        for (auto i = prime.begin(); i != prime.end(); ++i) {
+            primes.push_back(*i);
+        }
+        std::vector<int> expected;
+        std::copy_if(sorted.begin(), sorted.end(), std::back_inserter(expected), isPrime);
+        CHECK(primes == expected);
+
+        CHECK(built.contains(sorted.back()));
+        built.addElement(50001);
+        built.removeElement(sorted.front());
+        CHECK(built.size() == static_cast<int>(sorted.size()));
+    }
+
+    MagicalContainer empty = MagicalContainer::buildParallel({}, 4);
+    CHECK(empty.size() == 0);
+}
+
+// Chunked parallel traversal and ordered reductions
+TEST_CASE("parallel_for_each and parallel_reduce") {
+    std::vector<int> values(20000);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        values[i] = static_cast<int>(i * 3);
+    }
+    MagicalContainer container = MagicalContainer::buildParallel(values, 2);
+    WorkStealingPool pool(3);
+    CHECK(pool.threadCount() == 3);
+
+    SUBCASE("Every element is visited once") {
+        std::atomic<long long> sum{0};
+        std::atomic<int> count{0};
+        parallel_for_each(container, TraversalOrder::Ascending, [&](int element) {
+            sum += element;
+            ++count;
+        }, pool);
+        CHECK(count.load() == 20000);
+        CHECK(sum.load() == 3LL * 20000 * 19999 / 2);
+
+        std::atomic<int> primes{0};
+        parallel_for_each(container, TraversalOrder::Prime, [&](int element) {
+            if (isPrime(element)) {
+                ++primes;
+            }
+        }, pool);
+        CHECK(primes.load() == static_cast<int>(container.primeCount()));
+        CHECK(primes.load() == 1); // 3 is the only prime multiple of 3
+    }
+
+    SUBCASE("Reductions follow traversal order") {
+        for (TraversalOrder order :
+             {TraversalOrder::Ascending, TraversalOrder::SideCross, TraversalOrder::Prime}) {
+            std::vector<int> sequential;
+            if (order == TraversalOrder::Ascending) {
+                MagicalContainer::AscendingIterator it(container);
+                for (auto i = it.begin(); i != it.end(); ++i) {
+                    sequential.push_back(*i);
+                }
+            } else if (order == TraversalOrder::SideCross) {
+                MagicalContainer::SideCrossIterator it(container);
+                for (auto i = it.begin(); i != it.end(); ++i) {
+                    sequential.push_back(*i);
+                }
+            } else {
+                MagicalContainer::PrimeIterator it(container);
+                for (auto i = it.begin(); i != it.end(); ++i) {
+                    sequential.push_back(*i);
+                }
+            }
+            std::vector<int> collected = parallel_reduce(
+                container, order, std::vector<int>(),
+                [](int element) { return std::vector<int>{element}; },
+                [](std::vector<int> left, const std::vector<int> &right) {
+                    left.insert(left.end(), right.begin(), right.end());
+                    return left;
+                },
+                pool);
+            CHECK(collected == sequential);
+        }
+    }
+
+    SUBCASE("Floating point sums do not depend on the thread count") {
+        auto reciprocalSum = [&](WorkStealingPool &workers) {
+            return parallel_reduce(
+                container, TraversalOrder::SideCross, 0.0,
+                [](int element) { return 1.0 / (element + 1); },
+                [](double left, double right) { return left + right; }, workers);
+        };
+        WorkStealingPool single(1);
+        WorkStealingPool many(5);
+        double expected = reciprocalSum(single);
+        CHECK(reciprocalSum(many) == expected);
+        CHECK(reciprocalSum(pool) == expected);
+    }
+
+    SUBCASE("Exceptions reach the caller") {
+        CHECK_THROWS_AS(parallel_for_each(container, TraversalOrder::Ascending, [](int element) {
+            if (element == 30000) {
+                throw runtime_error("bad element");
+            }
+        }, pool), runtime_error);
+        MagicalContainer empty;
+        CHECK(parallel_reduce(empty, TraversalOrder::Prime, 7, [](int element) { return element; },
+                              [](int left, int right) { return left + right; }, pool) == 7);
+    }
+}
+
+// Splitting traversals into independent sub-ranges
+TEST_CASE("Splitting iterator ranges") {
+    MagicalContainer container;
+    for (int i = 1; i <= 23; ++i) {
+        container.addElement(i);
+    }
+
+    SUBCASE("AscendingIterator") {
+        MagicalContainer::AscendingIterator it(container);
+        auto ranges = it.begin().split(it.end(), 4);
+        REQUIRE(ranges.size() == 4);
+        std::vector<int> joined;
+        std::vector<std::size_t> sizes;
+        for (auto &range : ranges) {
+            std::size_t count = 0;
+            for (auto i = range.first; i != range.second; ++i, ++count) {
+                joined.push_back(*i);
+            }
+            sizes.push_back(count);
+        }
+        CHECK(sizes == std::vector<std::size_t>{6, 6, 6, 5});
+        std::vector<int> expected(23);
+        std::iota(expected.begin(), expected.end(), 1);
+        CHECK(joined == expected);
+    }
+
+    SUBCASE("SideCrossIterator keeps its interleaving") {
+        MagicalContainer::SideCrossIterator it(container);
+        std::vector<int> expected;
+        for (auto i = it.begin(); i != it.end(); ++i) {
+            expected.push_back(*i);
+        }
+        for (std::size_t parts : {1U, 2U, 3U, 5U, 23U, 30U}) {
+            std::vector<int> joined;
+            for (auto &range : it.begin().split(it.end(), parts)) {
+                for (auto i = range.first; i != range.second; ++i) {
+                    joined.push_back(*i);
+                }
+            }
+            CHECK(joined == expected);
+        }
+        auto halves = it.begin().split(it.end(), 2);
+        CHECK(*halves[1].first == 7); // position 12 is the 7th from the front
+    }
+
+    SUBCASE("PrimeIterator and sub-ranges of sub-ranges") {
+        MagicalContainer::PrimeIterator it(container);
+        auto ranges = it.begin().split(it.end(), 3);
+        CHECK(*ranges[0].first == 2);
+        CHECK(*ranges[1].first == 7);
+        CHECK(*ranges[2].first == 17);
+        auto inner = ranges[2].first.split(ranges[2].second, 2);
+        CHECK(*inner[1].first == 23);
+        CHECK(inner[1].second == it.end());
+        CHECK_THROWS_AS(it.begin().split(it.end(), 0), runtime_error);
+        CHECK_THROWS_AS(it.end().split(it.begin(), 2), runtime_error);
+
+        MagicalContainer other;
+        MagicalContainer::PrimeIterator foreign(other);
+        CHECK_THROWS_AS(it.begin().split(foreign.end(), 2), runtime_error);
+    }
+}
+
+// The iterators are random access, so standard algorithms accept them
+TEST_CASE("Iterators meet the random access requirements") {
+    static_assert(std::random_access_iterator<MagicalContainer::AscendingIterator>);
+    static_assert(std::random_access_iterator<MagicalContainer::SideCrossIterator>);
+    static_assert(std::random_access_iterator<MagicalContainer::PrimeIterator>);
+
+    MagicalContainer container;
+    for (int i = 1; i <= 20; ++i) {
+        container.addElement(i);
+    }
+
+    SUBCASE("Arithmetic agrees with increments") {
+        MagicalContainer::SideCrossIterator cross(container);
+        MagicalContainer::SideCrossIterator walked = cross.begin();
+        for (int step = 0; step < 20; ++step, ++walked) {
+            CHECK(cross.begin() + step == walked);
+            CHECK(cross.begin()[step] == *walked);
+            CHECK(walked - cross.begin() == step);
+        }
+        CHECK(walked == cross.end());
+        CHECK(*(cross.end() - 1) == 11);
+        CHECK(*--walked == 11);
+        CHECK(*(3 + cross.begin()) == 19);
+        CHECK(cross.begin() <= cross.end());
+        CHECK_THROWS_AS(cross.begin() - 1, runtime_error);
+        CHECK_THROWS_AS(cross.end() + 1, runtime_error);
+
+        MagicalContainer::PrimeIterator prime(container);
+        auto it = prime.begin();
+        CHECK(*it++ == 2);
+        CHECK(*it == 3);
+        CHECK(prime.end() - prime.begin() == 8);
+        CHECK_THROWS_AS(--prime.begin(), runtime_error);
+    }
+
+    SUBCASE("Standard algorithms") {
+        MagicalContainer::AscendingIterator ascending(container);
+        CHECK(std::reduce(ascending.begin(), ascending.end()) == 210);
+        CHECK(std::transform_reduce(ascending.begin(), ascending.end(), 0LL, std::plus<>(),
+                                    [](int element) { return 1LL * element * element; }) ==
+              2870);
+        CHECK(*std::lower_bound(ascending.begin(), ascending.end(), 13) == 13);
+        CHECK(std::distance(ascending.begin(), ascending.end()) == 20);
+
+        MagicalContainer::PrimeIterator prime(container);
+        CHECK(std::accumulate(prime.begin(), prime.end(), 0) == 77);
+        std::vector<int> reversed(prime.begin(), prime.end());
+        std::reverse(reversed.begin(), reversed.end());
+        CHECK(reversed.front() == 19);
+    }
+
+    SUBCASE("Default construction and assignment") {
+        MagicalContainer::AscendingIterator singular;
+        MagicalContainer::AscendingIterator it(container);
+        singular = it.begin() + 4;
+        CHECK(*singular == 5);
+
+        MagicalContainer other;
+        MagicalContainer::AscendingIterator foreign(other);
+        CHECK_THROWS_AS(singular = foreign, runtime_error);
+    }
+}
+
+// Batch merge and the multi-producer ingestion front-end
+TEST_CASE("Batched ingestion") {
+    SUBCASE("addElements merges a batch") {
+        MagicalContainer container;
+        container.addElement(4);
+        container.addElement(7);
+        container.addElement(10);
+        std::vector<int> batch = {11, 2, 7, 3, 11, -5, 13};
+        container.addElements(batch);
+        CHECK(container.size() == 8);
+
+        std::vector<int> ascending;
+        MagicalContainer::AscendingIterator it(container);
+        for (auto i = it.begin(); i != it.end(); ++i) {
+            ascending.push_back(*i);
+        }
+        CHECK(ascending == std::vector<int>{-5, 2, 3, 4, 7, 10, 11, 13});
+        std::vector<int> primes;
+        MagicalContainer::PrimeIterator prime(container);
+        for (auto i = prime.begin(); i != prime.end(); ++i) {
+            primes.push_back(*i);
+        }
+        CHECK(primes == std::vector<int>{2, 3, 7, 11, 13});
+        CHECK(container.contains(13));
+    }
+
+    SUBCASE("Producers feed one writer") {
+        ConcurrentMagicalContainer container;
+        {
+            BatchedIngestor ingestor(container, 256, std::chrono::milliseconds(5));
+            std::vector<std::thread> producers;
+            for (int p = 0; p < 4; ++p) {
+                producers.emplace_back([&ingestor, p] {
+                    for (int i = 0; i < 10000; ++i) {
+                        ingestor.add(i * 4 + p);
+                    }
+                });
+            }
+            for (std::thread &producer : producers) {
+                producer.join();
+            }
+            ingestor.flush();
+            CHECK(container.size() == 40000);
+            CHECK(ingestor.batchCount() < 40000);
+            ingestor.add(-1);
+        }
+        // The destructor publishes what is still queued
+        CHECK(container.size() == 40001);
+        CHECK(container.contains(-1));
+        CHECK(container.contains(39999));
+    }
+
+    SUBCASE("Rings of exited producers are reclaimed") {
+        ConcurrentMagicalContainer container;
+        BatchedIngestor first(container, 64, std::chrono::milliseconds(1));
+        BatchedIngestor second(container, 64, std::chrono::milliseconds(1));
+        for (int round = 0; round < 20; ++round) {
+            std::thread producer([&first, &second, round] {
+                for (int i = 0; i < 100; ++i) {
+                    (i % 2 == 0 ? first : second).add(round * 100 + i);
+                }
+            });
+            producer.join();
+        }
+        first.add(-1);
+        first.flush();
+        second.flush();
+        CHECK(container.size() == 2001);
+        CHECK(first.ringCount() == 1); // only this thread's
+        CHECK(second.ringCount() == 0);
+    }
+
+    SUBCASE("Latency bound flushes small batches") {
+        ConcurrentMagicalContainer container;
+        BatchedIngestor ingestor(container, 1000000, std::chrono::milliseconds(1));
+        ingestor.add(17);
+        for (int wait = 0; wait < 1000 && !container.contains(17); ++wait) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        CHECK(container.contains(17));
+    }
+}
+
+// Futures, group commits and the flush barrier
+TEST_CASE("AsyncMutationQueue") {
+    SUBCASE("Batches apply in submission order") {
+        ConcurrentMagicalContainer container;
+        container.addElement(1);
+        std::vector<ConcurrentMagicalContainer::Mutation> mutations = {
+            {ConcurrentMagicalContainer::Mutation::Kind::Add, 5},
+            {ConcurrentMagicalContainer::Mutation::Kind::Remove, 5},
+            {ConcurrentMagicalContainer::Mutation::Kind::Remove, 5},
+            {ConcurrentMagicalContainer::Mutation::Kind::Remove, 1},
+            {ConcurrentMagicalContainer::Mutation::Kind::Add, 7},
+        };
+        std::vector<bool> succeeded = container.applyBatch(mutations);
+        CHECK(succeeded == std::vector<bool>{true, true, false, true, true});
+        CHECK(container.size() == 1);
+        CHECK(container.contains(7));
+        CHECK_FALSE(container.contains(1));
+    }
+
+    SUBCASE("removeElements is all or nothing") {
+        MagicalContainer container;
+        container.addElements(std::vector<int>{2, 3, 4, 5, 6, 7});
+        CHECK_THROWS_AS(container.removeElements(std::vector<int>{3, 8}), runtime_error);
+        CHECK(container.size() == 6);
+        container.removeElements(std::vector<int>{3, 6, 3});
+        MagicalContainer::PrimeIterator prime(container);
+        CHECK(std::vector<int>(prime.begin(), prime.end()) == std::vector<int>{2, 5, 7});
+        CHECK(container.size() == 4);
+    }
+
+    SUBCASE("Futures report each mutation") {
+        ConcurrentMagicalContainer container;
+        AsyncMutationQueue queue(container);
+        std::future<void> added = queue.addElementAsync(3);
+        std::future<void> missing = queue.removeElementAsync(4);
+        added.get();
+        CHECK(container.contains(3));
+        CHECK_THROWS_AS(missing.get(), runtime_error);
+    }
+
+    SUBCASE("Concurrent callers share group commits") {
+        ConcurrentMagicalContainer container;
+        AsyncMutationQueue queue(container);
+        std::vector<std::thread> callers;
+        for (int c = 0; c < 4; ++c) {
+            callers.emplace_back([&queue, c] {
+                std::vector<std::future<void>> results;
+                for (int i = 0; i < 500; ++i) {
+                    results.push_back(queue.addElementAsync(i * 4 + c));
+                }
+                for (std::future<void> &result : results) {
+                    result.get();
+                }
+            });
+        }
+        for (std::thread &caller : callers) {
+            caller.join();
+        }
+        CHECK(container.size() == 2000);
+        CHECK(queue.commitCount() <= 2000);
+
+        for (int i = 0; i < 2000; i += 2) {
+            queue.removeElementAsync(i);
+        }
+        queue.flush();
+        CHECK(container.size() == 1000);
+        CHECK_FALSE(container.contains(0));
+        CHECK(container.contains(1999));
+    }
+}
+
+// Rebuilding into a shadow version while reads and writes continue
+TEST_CASE("ConcurrentMagicalContainer background rebuild") {
+    ConcurrentMagicalContainer container;
+    for (int i = 0; i < 50; ++i) {
+        container.addElement(i);
+    }
+
+    SUBCASE("Old readers keep their version") {
+        ConcurrentMagicalContainer::ReadGuard before = container.read();
+        std::vector<int> values(200000);
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            values[i] = static_cast<int>(values.size() - i);
+        }
+        std::future<void> rebuilt = container.rebuildAsync(values);
+        CHECK_THROWS_AS(container.rebuildAsync(), runtime_error);
+
+        // Writes racing the rebuild end up in the published version
+        container.addElement(-7);
+        container.removeElement(10);
+        std::vector<ConcurrentMagicalContainer::Mutation> batch = {
+            {ConcurrentMagicalContainer::Mutation::Kind::Add, -3},
+            {ConcurrentMagicalContainer::Mutation::Kind::Remove, 11},
+        };
+        container.applyBatch(batch);
+        rebuilt.get();
+
+        CHECK(before->size() == 50);
+        CHECK(container.size() == 200000 + 2 - 2);
+        CHECK(container.contains(-7));
+        CHECK(container.contains(-3));
+        CHECK_FALSE(container.contains(10));
+        CHECK_FALSE(container.contains(11));
+        CHECK(container.contains(200000));
+        ConcurrentMagicalContainer::ReadGuard after = container.read();
+        MagicalContainer::PrimeIterator primes(*after);
+        CHECK(*primes.begin() == 2);
+    }
+
+    SUBCASE("Rebuild from the current elements") {
+        container.rebuildAsync().get();
+        CHECK(container.size() == 50);
+        int out[3] = {};
+        CHECK(container.scan(47, out, 3) == 3);
+        CHECK(out[2] == 49);
+        container.rebuildAsync({}).get();
+        CHECK(container.size() == 0);
+    }
+}
+
+TEST_CASE("Live iterators survive mutations") {
+    MagicalContainer container;
+    for (int i = 10; i <= 20; i += 2) {
+        container.addElement(i); // 10 12 14 16 18 20
+    }
+
+    SUBCASE("Inserting before the cursor does not repeat an element") {
+        MagicalContainer::AscendingIterator it(container);
+        ++it;
+        CHECK(*it == 12);
+        container.addElement(1);
+        container.addElement(11);
+        CHECK(*it == 12);
+        ++it;
+        CHECK(*it == 14);
+        CHECK(it - it.begin() == 4);
+    }
+
+    SUBCASE("Inserting after the cursor is seen") {
+        MagicalContainer::AscendingIterator it(container);
+        ++it;
+        container.addElement(13);
+        ++it;
+        CHECK(*it == 13);
+    }
+
+    SUBCASE("Removing the current element moves to the next one") {
+        MagicalContainer::AscendingIterator it(container);
+        it += 2;
+        container.removeElement(14);
+        CHECK(*it == 16);
+        container.removeElement(16);
+        container.removeElement(18);
+        container.removeElement(20);
+        CHECK(it == it.end());
+        CHECK_THROWS(++it);
+    }
+
+    SUBCASE("An end iterator stays at the end") {
+        MagicalContainer::AscendingIterator end =
+            MagicalContainer::AscendingIterator(container).end();
+        container.addElement(30);
+        container.addElement(0);
+        CHECK(end == MagicalContainer::AscendingIterator(container).end());
+    }
+
+    SUBCASE("Prime iterator") {
+        container.addElement(7);
+        container.addElement(13);
+        container.addElement(19);
+        MagicalContainer::PrimeIterator it(container);
+        ++it;
+        CHECK(*it == 13);
+        container.addElement(2);
+        container.addElement(17);
+        CHECK(*it == 13);
+        container.removeElement(13);
+        CHECK(*it == 17);
+        ++it;
+        CHECK(*it == 19);
+        ++it;
+        CHECK(it == it.end());
+    }
+
+#ifndef NDEBUG
+    SUBCASE("A stale side cross iterator is reported in debug builds") {
+        MagicalContainer::SideCrossIterator it(container);
+        ++it;
+        CHECK(*it == 20);
+        container.addElement(22);
+        CHECK_THROWS_WITH(*it, "Iterator invalidated by a mutation");
+        CHECK_THROWS(++it);
+        it = it.begin();
+        CHECK(*it == 10);
+        CHECK(*++it == 22);
+    }
+#endif
+
+    SUBCASE("Assigning the container") {
+        MagicalContainer::AscendingIterator it(container);
+        it += 3;
+        MagicalContainer other;
+        other.addElement(15);
+        other.addElement(17);
+        container = other;
+        CHECK(*it == 17);
+    }
+}
+
+TEST_CASE("Copy-on-write snapshots") {
+    MagicalContainer container;
+    for (int i = 1; i <= 5000; ++i) {
+        container.addElement(i);
+    }
+    SnapshotView before = container.snapshot();
+
+    container.addElement(0);
+    container.addElement(6007);
+    for (int i = 2; i <= 5000; i += 2) {
+        container.removeElement(i);
+    }
+    SnapshotView after = container.snapshot();
+
+    SUBCASE("A view keeps its point in time") {
+        CHECK(before.size() == 5000);
+        CHECK(before.contains(2));
+        CHECK_FALSE(before.contains(0));
+        int expected = 1;
+        SnapshotView::AscendingIterator it(before);
+        for (; it != it.end(); ++it) {
+            CHECK(*it == expected++);
+        }
+        CHECK(expected == 5001);
+        CHECK_THROWS(++it);
+    }
+
+    SUBCASE("A later view sees the mutations") {
+        CHECK(after.size() == container.size());
+        CHECK(after.primeCount() == container.primeCount());
+        CHECK(after.contains(6007));
+        CHECK_FALSE(after.contains(2));
+        MagicalContainer::AscendingIterator live(container);
+        for (int element : SnapshotView::AscendingIterator(after)) {
+            CHECK(element == *live);
+            ++live;
+        }
+        CHECK(live == live.end());
+    }
+
+    SUBCASE("Side cross and prime order match the container") {
+        MagicalContainer::SideCrossIterator cross(container);
+        for (int element : SnapshotView::SideCrossIterator(after)) {
+            CHECK(element == *cross);
+            ++cross;
+        }
+        CHECK(cross == cross.end());
+        MagicalContainer::PrimeIterator prime(container);
+        for (int element : SnapshotView::PrimeIterator(after)) {
+            CHECK(element == *prime);
+            ++prime;
+        }
+        CHECK(prime == prime.end());
+
+        SnapshotView::PrimeIterator oldPrimes(before);
+        CHECK(*oldPrimes == 2);
+        std::size_t primes = 0;
+        for (; oldPrimes != oldPrimes.end(); ++oldPrimes) {
+            ++primes;
+        }
+        CHECK(primes == before.primeCount());
+    }
+
+    SUBCASE("Batches and copies") {
+        std::vector<int> batch = {-5, -3, 9000};
+        container.addElements(batch);
+        SnapshotView rebuilt = container.snapshot();
+        CHECK(rebuilt.size() == container.size());
+        CHECK(rebuilt.contains(-3));
+        CHECK_FALSE(after.contains(-3));
+
+        MagicalContainer copy(container);
+        copy.removeElement(9000);
+        CHECK(container.snapshot().contains(9000));
+        CHECK_FALSE(copy.snapshot().contains(9000));
+    }
+
+    SUBCASE("Views read on other threads while the writer goes on") {
+        // Only the readers hold the chunks they walk, so reference counts
+        // drop and rise while the writer keeps mutating
+        long long expected = 0;
+        for (int element : SnapshotView::AscendingIterator(after)) {
+            expected += element;
+        }
+        std::vector<std::thread> readers;
+        std::atomic<int> mismatches{0};
+        for (int r = 0; r < 2; ++r) {
+            readers.emplace_back([view = after, expected, &mismatches] {
+                for (int round = 0; round < 20; ++round) {
+                    long long sum = 0;
+                    for (int element : SnapshotView::AscendingIterator(view)) {
+                        sum += element;
+                    }
+                    mismatches += sum == expected ? 0 : 1;
+                }
+            });
+        }
+        after = SnapshotView();
+        before = SnapshotView();
+        for (int i = 1; i <= 4999; i += 2) {
+            container.removeElement(i);
+            if (i % 500 == 1) {
+                SnapshotView dropped = container.snapshot();
+            }
+        }
+        for (std::thread &reader : readers) {
+            reader.join();
+        }
+        CHECK(mismatches == 0);
+        CHECK(container.snapshot().size() == 2);
+    }
+
+    SUBCASE("Empty") {
+        MagicalContainer empty;
+        SnapshotView view = empty.snapshot();
+        empty.addElement(3);
+        CHECK(view.size() == 0);
+        CHECK(SnapshotView::SideCrossIterator(view) ==
+              SnapshotView::SideCrossIterator(view).end());
+        CHECK(*SnapshotView::PrimeIterator(empty.snapshot()) == 3);
+    }
+}
+
+TEST_CASE("PersistentMagicalContainer versions") {
+    PersistentMagicalContainer container(4);
+    CHECK(container.currentVersion() == 0);
+    for (int element : {5, 2, 9, 4, 7}) {
+        container.addElement(element); // versions 1-5
+    }
+    container.addElement(9); // present: no new version
+    CHECK(container.currentVersion() == 5);
+    CHECK(container.oldestVersion() == 2);
+    CHECK_THROWS_WITH(container.version(1), "Version not retained");
+
+    PersistentMagicalContainer::Version three = container.version(3);
+    container.removeElement(5);
+    container.addElement(11);
+    CHECK_THROWS(container.removeElement(5));
+    CHECK(container.size() == 5);
+
+    SUBCASE("Time travel") {
+        CHECK(three.size() == 3);
+        CHECK(three.contains(9));
+        CHECK_FALSE(three.contains(4));
+        std::vector<int> ascending;
+        for (int element : PersistentMagicalContainer::AscendingIterator(three)) {
+            ascending.push_back(element);
+        }
+        CHECK(ascending == std::vector<int>{2, 5, 9});
+
+        PersistentMagicalContainer::Version previous = container.versionsAgo(2);
+        CHECK(previous.contains(5));
+        CHECK_FALSE(previous.contains(11));
+        std::vector<int> primes;
+        for (int element : PersistentMagicalContainer::PrimeIterator(previous)) {
+            primes.push_back(element);
+        }
+        CHECK(primes == std::vector<int>{2, 5, 7});
+    }
+
+    SUBCASE("Current version matches MagicalContainer") {
+        MagicalContainer reference;
+        for (int element : {2, 9, 4, 7, 11}) {
+            reference.addElement(element);
+        }
+        PersistentMagicalContainer::Version current =
+            container.version(container.currentVersion());
+        MagicalContainer::SideCrossIterator cross(reference);
+        for (int element : PersistentMagicalContainer::SideCrossIterator(current)) {
+            CHECK(element == *cross);
+            ++cross;
+        }
+        CHECK(cross == cross.end());
+        CHECK(current.primeCount() == reference.primeCount());
+    }
+
+    SUBCASE("Retention window") {
+        CHECK(container.oldestVersion() == 4);
+        container.setRetention(1);
+        CHECK(container.oldestVersion() == container.currentVersion());
+        CHECK_THROWS(container.versionsAgo(1));
+        CHECK(three.size() == 3); // still alive through the handle
+    }
+
+    SUBCASE("Many versions") {
+        PersistentMagicalContainer large(1000);
+        for (int i = 0; i < 3000; ++i) {
+            large.addElement((i * 7919) % 3001);
+        }
+        for (int i = 0; i < 3000; i += 3) {
+            large.removeElement((i * 7919) % 3001);
+        }
+        PersistentMagicalContainer::Version old = large.versionsAgo(500);
+        CHECK(old.size() == 2500);
+        CHECK_FALSE(old.contains((1497 * 7919) % 3001));
+        CHECK(old.contains((1500 * 7919) % 3001));
+        int previous = -1;
+        for (int element : PersistentMagicalContainer::AscendingIterator(old)) {
+            CHECK(element > previous);
+            previous = element;
+        }
+    }
+}
+
+TEST_CASE("Binary snapshots and mapFromFile") {
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "magical_snapshot_test.bin").string();
+    MagicalContainer container;
+    for (int i = -50; i <= 3000; i += 3) {
+        container.addElement(i);
+    }
+    container.save(path);
+
+    SUBCASE("Round trip") {
+        MappedMagicalContainer mapped = MagicalContainer::mapFromFile(path);
+        CHECK(mapped.verify());
+        CHECK(mapped.size() == container.size());
+        CHECK(mapped.primeCount() == container.primeCount());
+        CHECK(mapped.contains(-50));
+        CHECK_FALSE(mapped.contains(0));
+
+        MagicalContainer::SideCrossIterator cross(container);
+        for (int element : MappedMagicalContainer::SideCrossIterator(mapped)) {
+            CHECK(element == *cross);
+            ++cross;
+        }
+        MagicalContainer::PrimeIterator prime(container);
+        for (int element : MappedMagicalContainer::PrimeIterator(mapped)) {
+            CHECK(element == *prime);
+            ++prime;
+        }
+        CHECK(prime == prime.end());
+
+        MappedMagicalContainer moved(std::move(mapped));
+        CHECK(*MappedMagicalContainer::AscendingIterator(moved) == -50);
+    }
+
+    SUBCASE("Corruption is detected") {
+        {
+            std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(sizeof(MappedMagicalContainer::Header) + 8);
+            file.put('\x7f');
+        }
+        CHECK_FALSE(MagicalContainer::mapFromFile(path).verify());
+
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) - 4);
+        CHECK_THROWS_WITH(MagicalContainer::mapFromFile(path),
+                          ("Truncated snapshot: " + path).c_str());
+        std::filesystem::resize_file(path, 10);
+        CHECK_THROWS(MagicalContainer::mapFromFile(path));
+        std::remove(path.c_str());
+        CHECK_THROWS(MagicalContainer::mapFromFile(path));
+    }
+
+    SUBCASE("Empty container and unsorted writes") {
+        MagicalContainer().save(path);
+        MappedMagicalContainer mapped = MagicalContainer::mapFromFile(path);
+        CHECK(mapped.size() == 0);
+        CHECK(mapped.verify());
+        CHECK(MappedMagicalContainer::PrimeIterator(mapped) ==
+              MappedMagicalContainer::PrimeIterator(mapped).end());
+
+        MappedMagicalContainer::Writer writer(path + ".other");
+        writer.add(5, true);
+        CHECK_THROWS(writer.add(5, true));
+        CHECK_FALSE(std::filesystem::exists(path + ".other"));
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("DurableMagicalContainer recovery") {
+    const std::string directory =
+        (std::filesystem::temp_directory_path() / "magical_wal_test").string();
+    std::filesystem::remove_all(directory);
+    const std::string log = directory + "/wal.log";
+
+    {
+        DurableMagicalContainer container(directory);
+        for (int i = 1; i <= 20; ++i) {
+            container.addElement(i);
+        }
+        container.removeElement(4);
+        CHECK_THROWS(container.removeElement(4));
+        container.addElement(7);
+        CHECK(container.syncCount() >= 1);
+    }
+
+    SUBCASE("Replay after restart") {
+        DurableMagicalContainer container(directory);
+        CHECK(container.size() == 19);
+        CHECK_FALSE(container.contains(4));
+        MagicalContainer::PrimeIterator primes(container.contents());
+        CHECK(*primes == 2);
+        CHECK(std::filesystem::file_size(log) == 21 * 12);
+    }
+
+    SUBCASE("Checkpoint then log tail") {
+        {
+            DurableMagicalContainer container(directory);
+            container.checkpoint();
+            CHECK(std::filesystem::file_size(log) == 0);
+            container.removeElement(20);
+            container.addElement(-1);
+        }
+        DurableMagicalContainer container(directory);
+        CHECK(container.size() == 19);
+        CHECK(container.contains(-1));
+        CHECK_FALSE(container.contains(20));
+        CHECK(std::filesystem::file_size(log) == 2 * 12);
+    }
+
+    SUBCASE("Replay keeps each element's last record") {
+        {
+            DurableMagicalContainer container(directory);
+            container.removeElement(5);
+            container.addElement(5);
+            container.removeElement(5);
+            container.addElement(100);
+            container.removeElement(100);
+            container.addElement(100);
+            container.addElement(4);
+        }
+        DurableMagicalContainer container(directory);
+        CHECK(container.size() == 20);
+        CHECK_FALSE(container.contains(5));
+        CHECK(container.contains(100));
+        CHECK(container.contains(4));
+        MagicalContainer::PrimeIterator primes(container.contents());
+        CHECK(*primes == 2);
+    }
+
+    SUBCASE("A torn record is cut off") {
+        {
+            std::ofstream file(log, std::ios::binary | std::ios::app);
+            file.write("\x01\x00\x00\x00\x63\x00", 6);
+        }
+        DurableMagicalContainer container(directory);
+        CHECK(container.size() == 19);
+        CHECK(std::filesystem::file_size(log) == 21 * 12);
+        container.addElement(99);
+        CHECK(std::filesystem::file_size(log) == 22 * 12);
+    }
+
+    SUBCASE("Group commit without waiting") {
+        {
+            DurableMagicalContainer container(directory, false);
+            std::vector<std::thread> writers;
+            for (int t = 0; t < 4; ++t) {
+                writers.emplace_back([&container, t] {
+                    for (int i = 0; i < 250; ++i) {
+                        container.addElement(1000 + t * 250 + i);
+                    }
+                });
+            }
+            for (std::thread &writer : writers) {
+                writer.join();
+            }
+            container.sync();
+            CHECK(container.syncCount() < 1000);
+        }
+        DurableMagicalContainer container(directory);
+        CHECK(container.size() == 1019);
+    }
+
+    SUBCASE("A failed group commit leaves the log as memory") {
+        // Writes past the size limit fail with EFBIG, some records in
+        std::vector<bool> kept;
+        {
+            DurableMagicalContainer container(directory, false);
+            struct rlimit saved {};
+            getrlimit(RLIMIT_FSIZE, &saved);
+            auto previous = std::signal(SIGXFSZ, SIG_IGN);
+            struct rlimit limit = saved;
+            limit.rlim_cur = 31 * 12 + 6;
+            setrlimit(RLIMIT_FSIZE, &limit);
+            for (int i = 0; i < 30; ++i) {
+                container.addElement(2000 + i);
+            }
+            CHECK_THROWS(container.sync());
+            CHECK_THROWS(container.addElement(3000));
+            setrlimit(RLIMIT_FSIZE, &saved);
+            std::signal(SIGXFSZ, previous);
+            for (int i = 0; i < 30; ++i) {
+                kept.push_back(container.contains(2000 + i));
+            }
+            CHECK(container.size() < 49);
+        }
+        DurableMagicalContainer container(directory);
+        for (int i = 0; i < 30; ++i) {
+            CHECK(container.contains(2000 + i) == kept[static_cast<std::size_t>(i)]);
+        }
+    }
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("loadText") {
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "magical_load_test.txt").string();
+    auto write = [&path](const std::string &text) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << text;
+    };
+
+    SUBCASE("Separators, signs and duplicates") {
+        write("5,3\n-7\r\n 11\t+2,,3\n\n17");
+        MagicalContainer container = MagicalContainer::loadText(path);
+        CHECK(container.size() == 6);
+        CHECK(container.contains(-7));
+        CHECK(container.primeCount() == 5);
+        MagicalContainer::AscendingIterator it(container);
+        CHECK(*it == -7);
+    }
+
+    SUBCASE("Numbers across read blocks") {
+        std::string text;
+        std::vector<int> expected;
+        for (int i = 0; text.size() < (std::size_t{3} << 20); ++i) {
+            int value = i * 7919 - 5000000;
+            expected.push_back(value);
+            text += std::to_string(value);
+            text += i % 3 == 0 ? "," : "\n";
+        }
+        write(text);
+        MagicalContainer container = MagicalContainer::loadText(path);
+        CHECK(container.size() == static_cast<int>(expected.size()));
+        bool all = true;
+        for (int value : expected) {
+            all = all && container.contains(value);
+        }
+        CHECK(all);
+    }
+
+    SUBCASE("Invalid input") {
+        write("1,2,x3\n");
+        CHECK_THROWS_WITH(MagicalContainer::loadText(path), "Invalid integer in input");
+        write("1\n99999999999\n");
+        CHECK_THROWS(MagicalContainer::loadText(path));
+        write("4,+-5\n");
+        CHECK_THROWS_WITH(MagicalContainer::loadText(path), "Invalid integer in input");
+        write("4 + 5\n");
+        CHECK_THROWS_WITH(MagicalContainer::loadText(path), "Invalid integer in input");
+        write("4,+");
+        CHECK_THROWS_WITH(MagicalContainer::loadText(path), "Invalid integer in input");
+        write("");
+        CHECK(MagicalContainer::loadText(path).size() == 0);
+        std::remove(path.c_str());
+        CHECK_THROWS(MagicalContainer::loadText(path));
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Exporting traversal orders") {
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "magical_export_test").string();
+    MagicalContainer container;
+    std::vector<int> values(200001);
+    std::iota(values.begin(), values.end(), -100000);
+    container.addElements(values);
+
+    auto readBinary = [&path] {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<int> read(std::filesystem::file_size(path) / sizeof(int));
+        file.read(reinterpret_cast<char *>(read.data()),
+                  static_cast<std::streamsize>(read.size() * sizeof(int)));
+        return read;
+    };
+    auto readText = [&path] {
+        std::ifstream file(path);
+        std::vector<int> read;
+        int value = 0;
+        while (file >> value) {
+            read.push_back(value);
+        }
+        return read;
+    };
+    auto traverse = [&container](auto it) {
+        std::vector<int> expected;
+        for (; it != it.end(); ++it) {
+            expected.push_back(*it);
+        }
+        return expected;
+    };
+    const std::vector<int> ascending =
+        traverse(MagicalContainer::AscendingIterator(container));
+    const std::vector<int> cross =
+        traverse(MagicalContainer::SideCrossIterator(container));
+    const std::vector<int> primes = traverse(MagicalContainer::PrimeIterator(container));
+
+    SUBCASE("Binary") {
+        container.exportTo(path, TraversalOrder::Ascending, ExportFormat::Binary);
+        CHECK(readBinary() == ascending);
+        container.exportTo(path, TraversalOrder::SideCross, ExportFormat::Binary);
+        CHECK(readBinary() == cross);
+        container.exportTo(path, TraversalOrder::Prime, ExportFormat::Binary);
+        CHECK(readBinary() == primes);
+    }
+
+    SUBCASE("Text") {
+        container.exportTo(path, TraversalOrder::Ascending, ExportFormat::Text);
+        CHECK(readText() == ascending);
+        container.exportTo(path, TraversalOrder::SideCross, ExportFormat::Text);
+        CHECK(readText() == cross);
+        container.exportTo(path, TraversalOrder::Prime, ExportFormat::Text);
+        CHECK(readText() == primes);
+        MagicalContainer reloaded = MagicalContainer::loadText(path);
+        CHECK(reloaded.size() == static_cast<int>(primes.size()));
+    }
+
+    SUBCASE("Small containers") {
+        MagicalContainer small;
+        small.exportTo(path, TraversalOrder::SideCross, ExportFormat::Text);
+        CHECK(std::filesystem::file_size(path) == 0);
+        small.addElement(7);
+        small.exportTo(path, TraversalOrder::SideCross, ExportFormat::Text);
+        CHECK(readText() == std::vector<int>{7});
+        CHECK_THROWS(small.exportTo("/nonexistent/dir/file", TraversalOrder::Prime,
+                                    ExportFormat::Binary));
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("ExternalMagicalBuilder") {
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "magical_external_test.bin").string();
+
+    SUBCASE("Runs are merged with duplicates dropped") {
+        // 13 runs at the minimum budget, one more than a single merge reads
+        std::mt19937 random(49);
+        std::uniform_int_distribution<int> value(-2000000, 2000000);
+        std::vector<int> values(13 * ((ExternalMagicalBuilder::MIN_BUDGET -
+                                       ExternalMagicalBuilder::WRITER_RESERVE) /
+                                      sizeof(int)));
+        for (int &v : values) {
+            v = value(random);
+        }
+        ExternalMagicalBuilder builder(path, 0);
+        builder.add(values);
+        CHECK(builder.runCount() == 13);
+        MappedMagicalContainer mapped = builder.finish();
+        CHECK(mapped.verify());
+
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+        std::vector<int> primes;
+        std::copy_if(values.begin(), values.end(), std::back_inserter(primes), isPrime);
+        CHECK(mapped.size() == static_cast<int>(values.size()));
+        CHECK(mapped.primeCount() == primes.size());
+        CHECK(std::equal(values.begin(), values.end(),
+                         MappedMagicalContainer::AscendingIterator(mapped)));
+        CHECK(std::equal(primes.begin(), primes.end(),
+                         MappedMagicalContainer::PrimeIterator(mapped)));
+
+        MappedMagicalContainer::SideCrossIterator cross(mapped);
+        for (std::size_t i = 0; i < 1000; ++i, ++cross) {
+            CHECK(*cross == (i % 2 == 0 ? values[i / 2] : values[values.size() - 1 - i / 2]));
+        }
+        auto runs = std::filesystem::directory_iterator(std::filesystem::temp_directory_path());
+        CHECK(std::none_of(std::filesystem::begin(runs), std::filesystem::end(runs),
+                           [](const std::filesystem::directory_entry &entry) {
+                               return entry.path().filename().string().find(
+                                          "magical_external_test.bin.run") == 0;
+                           }));
+    }
+
+    SUBCASE("Small input stays in memory") {
+        ExternalMagicalBuilder builder(path);
+        for (int i : {9, 2, 4, 2, 3, 9}) {
+            builder.add(i);
+        }
+        MappedMagicalContainer mapped = builder.finish();
+        CHECK(builder.runCount() == 0);
+        CHECK(mapped.size() == 4);
+        CHECK(mapped.primeCount() == 2);
+        CHECK(*MappedMagicalContainer::AscendingIterator(mapped) == 2);
+
+        MappedMagicalContainer empty = ExternalMagicalBuilder(path).finish();
+        CHECK(empty.size() == 0);
+        CHECK(empty.verify());
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("PagedMagicalContainer buffer pool") {
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "magical_paged_test.bin").string();
+    MagicalContainer container;
+    std::vector<int> values(20000);
+    std::iota(values.begin(), values.end(), -1000);
+    container.addElements(values);
+    container.save(path);
+    const std::size_t pages =
+        (std::filesystem::file_size(path) + PagedMagicalContainer::PAGE_SIZE - 1) /
+        PagedMagicalContainer::PAGE_SIZE;
+
+    SUBCASE("Traversals match the container") {
+        PagedMagicalContainer paged(path, 4);
+        CHECK(paged.size() == container.size());
+        CHECK(paged.primeCount() == container.primeCount());
+        CHECK(paged.contains(-1000));
+        CHECK(paged.contains(18999));
+        CHECK_FALSE(paged.contains(19000));
+
+        MagicalContainer::AscendingIterator ascending(container);
+        for (int element : PagedMagicalContainer::AscendingIterator(paged)) {
+            CHECK(element == *ascending);
+            ++ascending;
+        }
+        MagicalContainer::SideCrossIterator cross(container);
+        for (int element : PagedMagicalContainer::SideCrossIterator(paged)) {
+            CHECK(element == *cross);
+            ++cross;
+        }
+        MagicalContainer::PrimeIterator prime(container);
+        for (int element : PagedMagicalContainer::PrimeIterator(paged)) {
+            CHECK(element == *prime);
+            ++prime;
+        }
+        CHECK(prime == prime.end());
+
+        PagedMagicalContainer moved(std::move(paged));
+        CHECK(*PagedMagicalContainer::AscendingIterator(moved) == -1000);
+    }
+
+    SUBCASE("Metrics") {
+        PagedMagicalContainer paged(path, 4);
+        CHECK(paged.poolPages() == 4);
+        CHECK(paged.metrics().hitRate() == 0.0);
+
+        // A scan reads each page once and keeps only the last four
+        for (int element : PagedMagicalContainer::AscendingIterator(paged)) {
+            (void)element;
+        }
+        PagedMagicalContainer::Metrics scanned = paged.metrics();
+        CHECK(scanned.misses <= pages);
+        CHECK(scanned.evictions == scanned.misses - 4);
+        CHECK(scanned.hits + scanned.misses == values.size());
+        CHECK(scanned.readaheadHinted > 0);
+        CHECK(scanned.hitRate() > 0.99);
+
+        // Both ends of a side-cross walk stay resident
+        paged.resetMetrics();
+        for (int element : PagedMagicalContainer::SideCrossIterator(paged)) {
+            (void)element;
+        }
+        CHECK(paged.metrics().misses <= pages + 1);
+
+        // Searches keep revisiting the same few pages
+        PagedMagicalContainer searched(path, 8);
+        for (int round = 0; round < 100; ++round) {
+            CHECK(searched.contains(round));
+        }
+        CHECK(searched.metrics().misses < 10);
+        CHECK(searched.metrics().evictions == 0);
+    }
+
+    SUBCASE("Invalid files") {
+        CHECK_THROWS_WITH(PagedMagicalContainer(path + ".missing"),
+                          ("Cannot open snapshot: " + path + ".missing").c_str());
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) - 4);
+        CHECK_THROWS_WITH(PagedMagicalContainer{path},
+                          ("Truncated snapshot: " + path).c_str());
+        std::filesystem::resize_file(path, 10);
+        CHECK_THROWS(PagedMagicalContainer{path});
+    }
+    std::remove(path.c_str());
+}
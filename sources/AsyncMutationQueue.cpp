@@ -0,0 +1,92 @@
+#include "AsyncMutationQueue.hpp"
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+namespace ariel {
+
+AsyncMutationQueue::AsyncMutationQueue(ConcurrentMagicalContainer &target)
+    : target(target) {
+  worker = std::thread([this] { workerLoop(); });
+}
+
+AsyncMutationQueue::~AsyncMutationQueue() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  worker.join();
+}
+
+std::future<void> AsyncMutationQueue::submit(Mutation mutation) {
+  Pending entry{mutation, std::promise<void>()};
+  std::future<void> result = entry.done.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(std::move(entry));
+    ++submitted;
+  }
+  wake.notify_one();
+  return result;
+}
+
+std::future<void> AsyncMutationQueue::addElementAsync(int element) {
+  return submit({Mutation::Kind::Add, element});
+}
+
+std::future<void> AsyncMutationQueue::removeElementAsync(int element) {
+  return submit({Mutation::Kind::Remove, element});
+}
+
+void AsyncMutationQueue::workerLoop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    wake.wait(lock, [this] { return stopping || !pending.empty(); });
+    if (pending.empty())
+      return; // stopping, and nothing left to commit
+
+    std::vector<Pending> group;
+    group.swap(pending);
+    lock.unlock();
+
+    std::vector<Mutation> mutations;
+    mutations.reserve(group.size());
+    for (const Pending &entry : group) {
+      mutations.push_back(entry.mutation);
+    }
+    try {
+      std::vector<bool> succeeded = target.applyBatch(mutations);
+      for (std::size_t i = 0; i < group.size(); ++i) {
+        if (succeeded[i]) {
+          group[i].done.set_value();
+        } else {
+          group[i].done.set_exception(std::make_exception_ptr(
+              std::runtime_error("Element not found")));
+        }
+      }
+    } catch (...) {
+      for (Pending &entry : group) {
+        entry.done.set_exception(std::current_exception());
+      }
+    }
+
+    lock.lock();
+    applied += group.size();
+    ++commits;
+    committed.notify_all();
+  }
+}
+
+void AsyncMutationQueue::flush() {
+  std::unique_lock<std::mutex> lock(mutex);
+  const std::uint64_t barrier = submitted;
+  committed.wait(lock, [this, barrier] { return applied >= barrier; });
+}
+
+std::size_t AsyncMutationQueue::commitCount() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return commits;
+}
+
+} // namespace ariel
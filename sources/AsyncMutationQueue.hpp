@@ -0,0 +1,63 @@
+#ifndef ASYNCMUTATIONQUEUE_HPP
+#define ASYNCMUTATIONQUEUE_HPP
+
+#include "ConcurrentMagicalContainer.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ariel {
+
+// Asynchronous adds and removes for a ConcurrentMagicalContainer. Callers get
+// a future and return at once; a background worker takes everything queued
+// since its last commit and applies it as one group commit (one new version).
+// While a commit runs, new mutations queue up for the next one.
+class AsyncMutationQueue {
+private:
+  using Mutation = ConcurrentMagicalContainer::Mutation;
+
+  struct Pending {
+    Mutation mutation;
+    std::promise<void> done;
+  };
+
+  ConcurrentMagicalContainer &target;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable committed;
+  std::vector<Pending> pending;
+  std::uint64_t submitted = 0;
+  std::uint64_t applied = 0;
+  std::size_t commits = 0;
+  bool stopping = false;
+  std::thread worker;
+
+  std::future<void> submit(Mutation mutation);
+  void workerLoop();
+
+public:
+  explicit AsyncMutationQueue(ConcurrentMagicalContainer &target);
+  AsyncMutationQueue(const AsyncMutationQueue &) = delete;
+  AsyncMutationQueue &operator=(const AsyncMutationQueue &) = delete;
+  ~AsyncMutationQueue(); // commits what is still queued
+
+  // The future becomes ready once the change is visible to readers
+  std::future<void> addElementAsync(int element);
+
+  // As addElementAsync; the future throws if the element was not present
+  std::future<void> removeElementAsync(int element);
+
+  // Returns once every mutation submitted before the call is visible
+  void flush();
+
+  // Group commits applied so far
+  std::size_t commitCount();
+};
+
+} // namespace ariel
+
+#endif /* ASYNCMUTATIONQUEUE_HPP */
@@ -0,0 +1,136 @@
+#include "BatchedIngestor.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace ariel {
+
+namespace {
+
+// Ids are never reused, so an entry of a destroyed ingestor is never matched
+std::atomic<std::uint64_t> nextIngestorId{1};
+
+} // namespace
+
+thread_local BatchedIngestor::ThreadRings BatchedIngestor::threadRings;
+
+BatchedIngestor::ThreadRings::~ThreadRings() {
+  for (const auto &[owner, ring] : owned) {
+    ring->abandoned.store(true, std::memory_order_release);
+  }
+}
+
+BatchedIngestor::BatchedIngestor(ConcurrentMagicalContainer &target,
+                                 std::size_t flushSize,
+                                 std::chrono::microseconds flushLatency)
+    : target(target),
+      flushSize(std::clamp<std::size_t>(flushSize, 1, RING_CAPACITY)),
+      flushLatency(flushLatency), id(nextIngestorId.fetch_add(1)) {
+  writer = std::thread([this] { writerLoop(); });
+}
+
+BatchedIngestor::~BatchedIngestor() {
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  writer.join();
+  drain();
+  // Threads still alive hold their rings until they next register one
+  for (const std::shared_ptr<ProducerRing> &ring : rings) {
+    ring->closed.store(true, std::memory_order_relaxed);
+  }
+}
+
+BatchedIngestor::ProducerRing &BatchedIngestor::localRing() {
+  ThreadRings &local = threadRings;
+  if (local.lastId == id) {
+    return *local.lastRing;
+  }
+  auto found = std::find_if(local.owned.begin(), local.owned.end(),
+                            [this](const auto &entry) {
+                              return entry.first == id;
+                            });
+  if (found == local.owned.end()) {
+    std::erase_if(local.owned, [](const auto &entry) {
+      return entry.second->closed.load(std::memory_order_relaxed);
+    });
+    auto ring = std::make_shared<ProducerRing>();
+    {
+      std::lock_guard<std::mutex> lock(ringsMutex);
+      rings.push_back(ring);
+    }
+    found = local.owned.emplace(local.owned.end(), id, std::move(ring));
+  }
+  local.lastId = id;
+  local.lastRing = found->second.get();
+  return *local.lastRing;
+}
+
+void BatchedIngestor::add(int element) {
+  ProducerRing &ring = localRing();
+  const std::size_t head = ring.head.load(std::memory_order_relaxed);
+  while (head - ring.tail.load(std::memory_order_acquire) == RING_CAPACITY) {
+    wake.notify_one();
+    std::this_thread::yield();
+  }
+  ring.values[head % RING_CAPACITY] = element;
+  ring.head.store(head + 1, std::memory_order_release);
+
+  // Notifying without the mutex can miss a writer about to sleep; it then
+  // wakes at most flushLatency later
+  if (head + 1 - ring.tail.load(std::memory_order_relaxed) == flushSize) {
+    wake.notify_one();
+  }
+}
+
+// Single consumer of every ring
+void BatchedIngestor::drain() {
+  std::lock_guard<std::mutex> lock(drainMutex);
+  std::vector<int> batch;
+  {
+    std::lock_guard<std::mutex> registry(ringsMutex);
+    for (std::size_t r = 0; r < rings.size();) {
+      ProducerRing &ring = *rings[r];
+      // Read first: an exited thread's last values are then seen below
+      const bool abandoned = ring.abandoned.load(std::memory_order_acquire);
+      const std::size_t tail = ring.tail.load(std::memory_order_relaxed);
+      const std::size_t head = ring.head.load(std::memory_order_acquire);
+      for (std::size_t i = tail; i != head; ++i) {
+        batch.push_back(ring.values[i % RING_CAPACITY]);
+      }
+      ring.tail.store(head, std::memory_order_release);
+      if (abandoned) {
+        rings[r] = std::move(rings.back());
+        rings.pop_back();
+      } else {
+        ++r;
+      }
+    }
+  }
+  if (!batch.empty()) {
+    target.addElements(batch);
+    ++batches;
+  }
+}
+
+void BatchedIngestor::writerLoop() {
+  std::unique_lock<std::mutex> lock(wakeMutex);
+  while (!stopping) {
+    wake.wait_for(lock, flushLatency);
+    lock.unlock();
+    drain();
+    lock.lock();
+  }
+}
+
+void BatchedIngestor::flush() { drain(); }
+
+std::size_t BatchedIngestor::batchCount() const { return batches.load(); }
+
+std::size_t BatchedIngestor::ringCount() {
+  std::lock_guard<std::mutex> lock(ringsMutex);
+  return rings.size();
+}
+
+} // namespace ariel
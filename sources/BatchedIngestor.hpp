@@ -0,0 +1,95 @@
+#ifndef BATCHEDINGESTOR_HPP
+#define BATCHEDINGESTOR_HPP
+
+#include "ConcurrentMagicalContainer.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ariel {
+
+// Ingestion front-end for a ConcurrentMagicalContainer with many producers.
+// Each producer thread appends to its own single-producer ring without locks;
+// one writer thread drains every ring, merges the values as one batch and
+// publishes a single new version per batch.
+//
+// The writer wakes when a producer has flushSize values waiting, or after
+// flushLatency otherwise, whichever comes first.
+class BatchedIngestor {
+public:
+  static constexpr std::size_t RING_CAPACITY = 4096;
+
+private:
+  struct ProducerRing {
+    std::array<int, RING_CAPACITY> values;
+    alignas(64) std::atomic<std::size_t> head{0}; // advanced by the producer
+    alignas(64) std::atomic<std::size_t> tail{0}; // advanced by the writer
+    std::atomic<bool> abandoned{false}; // the producer thread has exited
+    std::atomic<bool> closed{false};    // the ingestor has been destroyed
+  };
+
+  // Rings the calling thread owns, one per live ingestor it has used. The
+  // ring used last is found without a scan; entries of destroyed ingestors
+  // are dropped when the thread next registers a ring.
+  struct ThreadRings {
+    std::vector<std::pair<std::uint64_t, std::shared_ptr<ProducerRing>>> owned;
+    std::uint64_t lastId = 0;
+    ProducerRing *lastRing = nullptr;
+    ~ThreadRings(); // at thread exit: marks the rings abandoned
+  };
+  static thread_local ThreadRings threadRings;
+
+  ConcurrentMagicalContainer &target;
+  const std::size_t flushSize;
+  const std::chrono::microseconds flushLatency;
+  const std::uint64_t id; // tells rings of this ingestor apart per thread
+
+  // A thread registers its ring on first add(); drain() drops the ring once
+  // its thread has exited and it is empty
+  std::mutex ringsMutex;
+  std::vector<std::shared_ptr<ProducerRing>> rings;
+
+  std::mutex drainMutex; // one drain at a time: the writer or flush()
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  std::atomic<std::size_t> batches{0};
+  std::thread writer;
+
+  ProducerRing &localRing();
+  void drain();
+  void writerLoop();
+
+public:
+  explicit BatchedIngestor(
+      ConcurrentMagicalContainer &target, std::size_t flushSize = 1024,
+      std::chrono::microseconds flushLatency = std::chrono::milliseconds(1));
+  BatchedIngestor(const BatchedIngestor &) = delete;
+  BatchedIngestor &operator=(const BatchedIngestor &) = delete;
+  ~BatchedIngestor(); // publishes whatever is still queued
+
+  // Queues element for the writer; spins only while this thread's ring is
+  // full
+  void add(int element);
+
+  // Publishes everything added before the call
+  void flush();
+
+  // Batches published so far
+  std::size_t batchCount() const;
+
+  // Rings held for producer threads, live or not yet drained
+  std::size_t ringCount();
+};
+
+} // namespace ariel
+
+#endif /* BATCHEDINGESTOR_HPP */
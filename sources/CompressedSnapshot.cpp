@@ -0,0 +1,290 @@
+#include "CompressedSnapshot.hpp"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace ariel {
+
+namespace {
+
+constexpr std::size_t NO_BLOCK = static_cast<std::size_t>(-1);
+
+// Index of the first set bit at or after from, or 128 if there is none
+std::size_t nextBit(const std::uint64_t (&mask)[2], std::size_t from) {
+  for (std::size_t word = from / 64; word < 2; ++word) {
+    std::uint64_t bits = mask[word];
+    if (word == from / 64) {
+      bits &= ~std::uint64_t{0} << (from % 64);
+    }
+    if (bits != 0) {
+      return word * 64 + static_cast<std::size_t>(std::countr_zero(bits));
+    }
+  }
+  return CompressedSnapshot::BLOCK_SIZE;
+}
+
+} // namespace
+
+CompressedSnapshot::CompressedSnapshot(const std::vector<int> &sorted,
+                                       const std::vector<std::size_t> &primes)
+    : count(sorted.size()), primeCount(primes.size()) {
+  const std::size_t lanes = LANES;
+  auto nextPrime = primes.begin();
+  blocks.reserve((count + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+  for (std::size_t start = 0; start < count; start += BLOCK_SIZE) {
+    std::size_t length = std::min(BLOCK_SIZE, count - start);
+    Block block;
+    block.first = sorted[start];
+    block.offset = packed.size();
+    block.primesBefore = static_cast<std::size_t>(nextPrime - primes.begin());
+
+    std::uint32_t deltas[BLOCK_SIZE] = {};
+    std::uint32_t largest = 0;
+    for (std::size_t i = 1; i < length; ++i) {
+      deltas[i] = static_cast<std::uint32_t>(sorted[start + i]) -
+                  static_cast<std::uint32_t>(sorted[start + i - 1]);
+      largest = std::max(largest, deltas[i]);
+    }
+    for (; nextPrime != primes.end() && *nextPrime < start + length;
+         ++nextPrime) {
+      std::size_t i = *nextPrime - start;
+      block.primeMask[i / 64] |= std::uint64_t{1} << (i % 64);
+    }
+    block.width = static_cast<std::uint32_t>(std::bit_width(largest));
+
+    // Lane l holds values l, l+4, l+8, ...; word w of every lane is stored
+    // next to each other so one load covers all four lanes
+    packed.resize(packed.size() + lanes * block.width);
+    for (std::size_t i = 0; i < BLOCK_SIZE && block.width > 0; ++i) {
+      std::size_t bit = (i / lanes) * block.width;
+      std::size_t word = block.offset + (bit / 32) * lanes + i % lanes;
+      std::size_t shift = bit % 32;
+      packed[word] |= deltas[i] << shift;
+      if (shift + block.width > 32) {
+        packed[word + lanes] |= deltas[i] >> (32 - shift);
+      }
+    }
+    blocks.push_back(block);
+  }
+}
+
+std::size_t CompressedSnapshot::blockLength(std::size_t block) const {
+  return std::min(BLOCK_SIZE, count - block * BLOCK_SIZE);
+}
+
+void CompressedSnapshot::decodeBlock(std::size_t block, int *out) const {
+  const Block &header = blocks[block];
+  std::uint32_t deltas[BLOCK_SIZE] = {};
+  if (header.width > 0) {
+    const std::uint32_t mask = header.width == 32
+                                   ? ~std::uint32_t{0}
+                                   : (std::uint32_t{1} << header.width) - 1;
+    const std::uint32_t *words = packed.data() + header.offset;
+    const std::size_t lastWord = header.width - 1;
+    for (std::size_t k = 0; k < BLOCK_SIZE / LANES; ++k) {
+      std::size_t bit = k * header.width;
+      std::size_t word = bit / 32;
+      std::size_t shift = bit % 32;
+      const std::uint32_t *lo = words + word * LANES;
+      const std::uint32_t *hi = word < lastWord ? lo + LANES : lo;
+      for (std::size_t lane = 0; lane < LANES; ++lane) {
+        std::uint64_t pair =
+            lo[lane] | (static_cast<std::uint64_t>(hi[lane]) << 32U);
+        deltas[k * LANES + lane] =
+            static_cast<std::uint32_t>(pair >> shift) & mask;
+      }
+    }
+  }
+
+  auto running = static_cast<std::uint32_t>(header.first);
+  std::size_t length = blockLength(block);
+  for (std::size_t i = 0; i < length; ++i) {
+    running += deltas[i];
+    out[i] = static_cast<int>(running);
+  }
+}
+
+int CompressedSnapshot::size() const { return static_cast<int>(count); }
+
+int CompressedSnapshot::primes() const { return static_cast<int>(primeCount); }
+
+std::size_t CompressedSnapshot::lowerBound(int value) const {
+  auto it = std::upper_bound(
+      blocks.begin(), blocks.end(), value,
+      [](int v, const Block &block) { return v < block.first; });
+  if (it == blocks.begin())
+    return 0;
+  auto block = static_cast<std::size_t>(it - blocks.begin()) - 1;
+  int values[BLOCK_SIZE];
+  decodeBlock(block, values);
+  std::size_t length = blockLength(block);
+  return block * BLOCK_SIZE +
+         static_cast<std::size_t>(std::lower_bound(values, values + length,
+                                                   value) -
+                                  values);
+}
+
+bool CompressedSnapshot::contains(int value) const {
+  std::size_t position = lowerBound(value);
+  if (position >= count)
+    return false;
+  int values[BLOCK_SIZE];
+  decodeBlock(position / BLOCK_SIZE, values);
+  return values[position % BLOCK_SIZE] == value;
+}
+
+std::size_t CompressedSnapshot::memoryUsage() const {
+  return blocks.capacity() * sizeof(Block) +
+         packed.capacity() * sizeof(std::uint32_t);
+}
+
+// AscendingIterator
+CompressedSnapshot::AscendingIterator::AscendingIterator(
+    const CompressedSnapshot &snap, std::size_t index)
+    : snapshot(&snap), currentIndex(std::min(index, snap.count)),
+      decodedBlock(NO_BLOCK) {
+  if (currentIndex < snapshot->count) {
+    decodedBlock = currentIndex / BLOCK_SIZE;
+    snapshot->decodeBlock(decodedBlock, buffer.data());
+  }
+}
+
+bool CompressedSnapshot::AscendingIterator::operator==(
+    const AscendingIterator &other) const {
+  return currentIndex == other.currentIndex;
+}
+
+bool CompressedSnapshot::AscendingIterator::operator!=(
+    const AscendingIterator &other) const {
+  return !(*this == other);
+}
+
+bool CompressedSnapshot::AscendingIterator::operator>(
+    const AscendingIterator &other) const {
+  return currentIndex > other.currentIndex;
+}
+
+bool CompressedSnapshot::AscendingIterator::operator<(
+    const AscendingIterator &other) const {
+  return currentIndex < other.currentIndex;
+}
+
+int CompressedSnapshot::AscendingIterator::operator*() const {
+  if (currentIndex >= snapshot->count) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  return buffer[currentIndex % BLOCK_SIZE];
+}
+
+CompressedSnapshot::AscendingIterator &
+CompressedSnapshot::AscendingIterator::operator++() {
+  if (currentIndex >= snapshot->count) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++currentIndex;
+  if (currentIndex < snapshot->count &&
+      currentIndex / BLOCK_SIZE != decodedBlock) {
+    decodedBlock = currentIndex / BLOCK_SIZE;
+    snapshot->decodeBlock(decodedBlock, buffer.data());
+  }
+  return *this;
+}
+
+CompressedSnapshot::AscendingIterator
+CompressedSnapshot::AscendingIterator::begin() const {
+  return AscendingIterator(*snapshot, 0);
+}
+
+CompressedSnapshot::AscendingIterator
+CompressedSnapshot::AscendingIterator::end() const {
+  return AscendingIterator(*snapshot, snapshot->count);
+}
+
+// PrimeIterator
+CompressedSnapshot::PrimeIterator::PrimeIterator(const CompressedSnapshot &snap,
+                                                 std::size_t index)
+    : snapshot(&snap), currentIndex(std::min(index, snap.primeCount)),
+      block(snap.blocks.size()), offset(0), decodedBlock(NO_BLOCK) {
+  if (currentIndex == snapshot->primeCount)
+    return;
+
+  auto it = std::upper_bound(snapshot->blocks.begin(), snapshot->blocks.end(),
+                             currentIndex,
+                             [](std::size_t i, const Block &candidate) {
+                               return i < candidate.primesBefore;
+                             });
+  block = static_cast<std::size_t>(it - snapshot->blocks.begin()) - 1;
+  std::size_t skip = currentIndex - snapshot->blocks[block].primesBefore;
+  offset = nextBit(snapshot->blocks[block].primeMask, 0);
+  for (; skip > 0; --skip) {
+    offset = nextBit(snapshot->blocks[block].primeMask, offset + 1);
+  }
+  settle();
+}
+
+void CompressedSnapshot::PrimeIterator::settle() {
+  if (block < snapshot->blocks.size() && block != decodedBlock) {
+    decodedBlock = block;
+    snapshot->decodeBlock(block, buffer.data());
+  }
+}
+
+bool CompressedSnapshot::PrimeIterator::operator==(
+    const PrimeIterator &other) const {
+  return currentIndex == other.currentIndex;
+}
+
+bool CompressedSnapshot::PrimeIterator::operator!=(
+    const PrimeIterator &other) const {
+  return !(*this == other);
+}
+
+bool CompressedSnapshot::PrimeIterator::operator>(
+    const PrimeIterator &other) const {
+  return currentIndex > other.currentIndex;
+}
+
+bool CompressedSnapshot::PrimeIterator::operator<(
+    const PrimeIterator &other) const {
+  return currentIndex < other.currentIndex;
+}
+
+int CompressedSnapshot::PrimeIterator::operator*() const {
+  if (currentIndex >= snapshot->primeCount) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  return buffer[offset];
+}
+
+CompressedSnapshot::PrimeIterator &
+CompressedSnapshot::PrimeIterator::operator++() {
+  if (currentIndex >= snapshot->primeCount) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++currentIndex;
+  if (currentIndex == snapshot->primeCount) {
+    block = snapshot->blocks.size();
+    offset = 0;
+    return *this;
+  }
+  offset = nextBit(snapshot->blocks[block].primeMask, offset + 1);
+  while (offset == BLOCK_SIZE) {
+    ++block;
+    offset = nextBit(snapshot->blocks[block].primeMask, 0);
+  }
+  settle();
+  return *this;
+}
+
+CompressedSnapshot::PrimeIterator
+CompressedSnapshot::PrimeIterator::begin() const {
+  return PrimeIterator(*snapshot, 0);
+}
+
+CompressedSnapshot::PrimeIterator
+CompressedSnapshot::PrimeIterator::end() const {
+  return PrimeIterator(*snapshot, snapshot->primeCount);
+}
+
+} // namespace ariel
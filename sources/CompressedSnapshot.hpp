@@ -0,0 +1,117 @@
+#ifndef COMPRESSEDSNAPSHOT_HPP
+#define COMPRESSEDSNAPSHOT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ariel {
+
+// Immutable, delta-compressed copy of a sorted set of integers. Values are
+// grouped in blocks of 128; each block keeps its first value and bit-packs
+// the deltas in four interleaved 32-value lanes so a block can be unpacked
+// four lanes at a time. The per-block first values form a skip index.
+class CompressedSnapshot {
+public:
+  static constexpr std::size_t BLOCK_SIZE = 128;
+
+private:
+  static constexpr std::size_t LANES = 4;
+
+  struct Block {
+    int first = 0;
+    std::uint32_t width = 0;       // bits per delta
+    std::size_t offset = 0;        // first word in packed
+    std::size_t primesBefore = 0;  // primes in earlier blocks
+    std::uint64_t primeMask[2]{};  // bit i set if value i is prime
+  };
+
+  std::vector<Block> blocks;
+  std::vector<std::uint32_t> packed;
+  std::size_t count = 0;
+  std::size_t primeCount = 0;
+
+  std::size_t blockLength(std::size_t block) const;
+  void decodeBlock(std::size_t block, int *out) const;
+
+public:
+  CompressedSnapshot() = default;
+  // primes holds the ascending positions in sorted of its prime values
+  CompressedSnapshot(const std::vector<int> &sorted,
+                     const std::vector<std::size_t> &primes);
+
+  int size() const;
+  int primes() const;
+  bool contains(int value) const;
+
+  // Position of the first element >= value, found through the skip index
+  std::size_t lowerBound(int value) const;
+
+  // Bytes used by the packed deltas and the block index
+  std::size_t memoryUsage() const;
+
+  class AscendingIterator {
+  private:
+    const CompressedSnapshot *snapshot;
+    std::size_t currentIndex;
+    std::size_t decodedBlock;
+    std::array<int, BLOCK_SIZE> buffer{};
+
+  public:
+    // Constructor
+    AscendingIterator(const CompressedSnapshot &snap, std::size_t index = 0);
+
+    // Comparison operators
+    bool operator==(const AscendingIterator &other) const;
+    bool operator!=(const AscendingIterator &other) const;
+    bool operator>(const AscendingIterator &other) const;
+    bool operator<(const AscendingIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    AscendingIterator &operator++();
+
+    // Iterator begin and end functions
+    AscendingIterator begin() const;
+    AscendingIterator end() const;
+  };
+
+  class PrimeIterator {
+  private:
+    const CompressedSnapshot *snapshot;
+    std::size_t currentIndex;
+    std::size_t block;
+    std::size_t offset;
+    std::size_t decodedBlock;
+    std::array<int, BLOCK_SIZE> buffer{};
+
+    void settle();
+
+  public:
+    // Constructor
+    PrimeIterator(const CompressedSnapshot &snap, std::size_t index = 0);
+
+    // Comparison operators
+    bool operator==(const PrimeIterator &other) const;
+    bool operator!=(const PrimeIterator &other) const;
+    bool operator>(const PrimeIterator &other) const;
+    bool operator<(const PrimeIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    PrimeIterator &operator++();
+
+    // Iterator begin and end functions
+    PrimeIterator begin() const;
+    PrimeIterator end() const;
+  };
+};
+
+} // namespace ariel
+
+#endif /* COMPRESSEDSNAPSHOT_HPP */
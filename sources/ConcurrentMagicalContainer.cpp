@@ -0,0 +1,374 @@
+#include "ConcurrentMagicalContainer.hpp"
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace ariel {
+
+namespace {
+
+std::size_t mirrorLowerBound(const std::atomic<int> *values, std::size_t count,
+                             int value) {
+  std::size_t low = 0;
+  std::size_t high = count;
+  while (low < high) {
+    std::size_t mid = low + (high - low) / 2;
+    if (values[mid].load(std::memory_order_acquire) < value) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+} // namespace
+
+ConcurrentMagicalContainer::ConcurrentMagicalContainer()
+    : ConcurrentMagicalContainer(MagicalContainer()) {}
+
+ConcurrentMagicalContainer::ConcurrentMagicalContainer(
+    const MagicalContainer &initial) {
+  auto first = std::make_unique<MagicalContainer>(initial);
+  first->prepareLookups();
+  updateMirror(*first, INT_MIN);
+  current.store(first.release());
+}
+
+ConcurrentMagicalContainer::~ConcurrentMagicalContainer() {
+  if (rebuilder.joinable()) {
+    rebuilder.join();
+  }
+  delete current.load();
+}
+
+// Readers spread over the slots by thread id so they rarely share a line.
+// Waiting for a slot could wait forever on guards the caller itself holds,
+// so a full pass without a free slot throws.
+std::size_t ConcurrentMagicalContainer::acquireSlot() {
+  std::size_t start =
+      std::hash<std::thread::id>{}(std::this_thread::get_id()) % MAX_READERS;
+  for (std::size_t i = 0; i < MAX_READERS; ++i) {
+    ReaderSlot &candidate = readers[(start + i) % MAX_READERS];
+    bool expected = false;
+    if (!candidate.taken.load(std::memory_order_relaxed) &&
+        candidate.taken.compare_exchange_strong(expected, true,
+                                                std::memory_order_acquire)) {
+      return (start + i) % MAX_READERS;
+    }
+  }
+  throw std::runtime_error("Too many readers");
+}
+
+void ConcurrentMagicalContainer::releaseSlot(std::size_t slot) {
+  readers[slot].epoch.store(IDLE, std::memory_order_release);
+  readers[slot].taken.store(false, std::memory_order_release);
+}
+
+// Caller holds writerMutex
+void ConcurrentMagicalContainer::publish(std::unique_ptr<MagicalContainer> next) {
+  next->prepareLookups();
+  MagicalContainer *old = current.exchange(next.release());
+  std::uint64_t epoch = globalEpoch.fetch_add(1);
+  retired.emplace_back(epoch, std::unique_ptr<MagicalContainer>(old));
+  reclaim();
+}
+
+// A version retired at epoch e can only be seen by readers that announced an
+// epoch <= e; free it once every active reader is past that
+void ConcurrentMagicalContainer::reclaim() {
+  std::uint64_t oldest = IDLE;
+  for (const ReaderSlot &reader : readers) {
+    oldest = std::min(oldest, reader.epoch.load());
+  }
+  retired.erase(std::remove_if(retired.begin(), retired.end(),
+                               [oldest](const auto &entry) {
+                                 return entry.first < oldest;
+                               }),
+                retired.end());
+}
+
+// Writer side of the seqlock: an odd sequence marks the update window. Data
+// stores are release and reader loads acquire, which orders them against the
+// sequence without standalone fences. Caller holds writerMutex (or is the
+// constructor).
+void ConcurrentMagicalContainer::updateMirror(MagicalContainer &version,
+                                              int changed) {
+  const std::size_t count = static_cast<std::size_t>(version.size());
+  MirrorBuffer *buffer = mirror.load(std::memory_order_relaxed);
+  std::size_t from =
+      buffer == nullptr
+          ? 0
+          : mirrorLowerBound(buffer->values.get(),
+                             mirrorSize.load(std::memory_order_relaxed),
+                             changed);
+
+  const std::uint64_t before = sequence.load(std::memory_order_relaxed);
+  sequence.store(before + 1, std::memory_order_relaxed);
+
+  if (buffer == nullptr || count > buffer->capacity) {
+    auto grown = std::make_unique<MirrorBuffer>();
+    grown->capacity = std::max<std::size_t>(16, count * 2);
+    grown->values = std::make_unique<std::atomic<int>[]>(grown->capacity);
+    for (std::size_t i = 0; i < from; ++i) {
+      grown->values[i].store(buffer->values[i].load(std::memory_order_relaxed),
+                             std::memory_order_release);
+    }
+    buffer = grown.get();
+    mirror.store(buffer, std::memory_order_release);
+    mirrorBuffers.push_back(std::move(grown));
+  }
+  MagicalContainer::AscendingIterator it(version, from);
+  for (std::size_t i = from; it != it.end(); ++it, ++i) {
+    buffer->values[i].store(*it, std::memory_order_release);
+  }
+  mirrorSize.store(count, std::memory_order_release);
+
+  sequence.store(before + 2, std::memory_order_release);
+}
+
+// Reader side: run read over the mirror until no writer overlapped it
+template <typename Read>
+auto ConcurrentMagicalContainer::readOptimistic(Read read) const {
+  for (;;) {
+    const std::uint64_t before = sequence.load(std::memory_order_acquire);
+    if ((before & 1U) != 0) {
+      std::this_thread::yield();
+      continue;
+    }
+    const MirrorBuffer *buffer = mirror.load(std::memory_order_acquire);
+    std::size_t count = std::min(mirrorSize.load(std::memory_order_acquire),
+                                 buffer->capacity);
+    auto result = read(buffer->values.get(), count);
+    if (sequence.load(std::memory_order_relaxed) == before) {
+      return result;
+    }
+  }
+}
+
+void ConcurrentMagicalContainer::addElement(int element) {
+  std::lock_guard<std::mutex> lock(writerMutex);
+  if (rebuilding) {
+    replay.push_back({Mutation::Kind::Add, element});
+  }
+  MagicalContainer *latest = current.load();
+  if (latest->contains(element))
+    return;
+  auto next = std::make_unique<MagicalContainer>(*latest);
+  next->addElement(element);
+  MagicalContainer &published = *next;
+  publish(std::move(next));
+  updateMirror(published, element);
+}
+
+void ConcurrentMagicalContainer::addElements(std::span<const int> elements) {
+  if (elements.empty())
+    return;
+  std::lock_guard<std::mutex> lock(writerMutex);
+  if (rebuilding) {
+    for (int element : elements) {
+      replay.push_back({Mutation::Kind::Add, element});
+    }
+  }
+  MagicalContainer *latest = current.load();
+  auto next = std::make_unique<MagicalContainer>(*latest);
+  next->addElements(elements);
+  if (next->size() == latest->size())
+    return;
+  MagicalContainer &published = *next;
+  publish(std::move(next));
+  updateMirror(published, *std::min_element(elements.begin(), elements.end()));
+}
+
+// Resolves the sequence to its net effect first, so applying it costs one
+// bulk removal and one bulk merge however many mutations there are
+int ConcurrentMagicalContainer::applyNetEffect(
+    MagicalContainer &version, std::span<const Mutation> mutations,
+    std::vector<bool> *succeeded) {
+  std::unordered_map<int, bool> present;
+  for (const Mutation &mutation : mutations) {
+    auto found = present.find(mutation.element);
+    bool there = found != present.end() ? found->second
+                                        : version.contains(mutation.element);
+    present[mutation.element] = mutation.kind == Mutation::Kind::Add;
+    if (succeeded != nullptr) {
+      succeeded->push_back(mutation.kind == Mutation::Kind::Add || there);
+    }
+  }
+
+  std::vector<int> added;
+  std::vector<int> removed;
+  int lowest = INT_MAX;
+  for (const auto &[element, there] : present) {
+    if (there != version.contains(element)) {
+      (there ? added : removed).push_back(element);
+      lowest = std::min(lowest, element);
+    }
+  }
+  version.removeElements(removed);
+  version.addElements(added);
+  return lowest;
+}
+
+std::vector<bool>
+ConcurrentMagicalContainer::applyBatch(std::span<const Mutation> mutations) {
+  std::vector<bool> succeeded;
+  succeeded.reserve(mutations.size());
+  std::lock_guard<std::mutex> lock(writerMutex);
+  auto next = std::make_unique<MagicalContainer>(*current.load());
+  int lowest = applyNetEffect(*next, mutations, &succeeded);
+  if (rebuilding) {
+    for (std::size_t i = 0; i < mutations.size(); ++i) {
+      if (succeeded[i]) {
+        replay.push_back(mutations[i]);
+      }
+    }
+  }
+  if (lowest == INT_MAX)
+    return succeeded;
+
+  MagicalContainer &published = *next;
+  publish(std::move(next));
+  updateMirror(published, lowest);
+  return succeeded;
+}
+
+std::future<void> ConcurrentMagicalContainer::rebuildAsync() {
+  std::vector<int> values;
+  {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    MagicalContainer::AscendingIterator it(*current.load());
+    values.assign(it.begin(), it.end());
+  }
+  return rebuildAsync(std::move(values));
+}
+
+// The shadow is built and indexed without the writer lock; only replaying
+// the logged writes and the swap itself hold it
+std::future<void> ConcurrentMagicalContainer::rebuildAsync(
+    std::vector<int> values) {
+  std::lock_guard<std::mutex> lock(writerMutex);
+  if (rebuilding) {
+    throw std::runtime_error("Rebuild already running");
+  }
+  if (rebuilder.joinable()) {
+    rebuilder.join(); // the previous rebuild has finished its work
+  }
+  rebuilding = true;
+  replay.clear();
+
+  auto done = std::make_shared<std::promise<void>>();
+  std::future<void> result = done->get_future();
+  rebuilder = std::thread([this, values = std::move(values), done] {
+    try {
+      auto shadow = std::make_unique<MagicalContainer>(
+          MagicalContainer::buildParallel(values));
+      shadow->prepareLookups();
+
+      std::lock_guard<std::mutex> swapLock(writerMutex);
+      applyNetEffect(*shadow, replay, nullptr);
+      rebuilding = false;
+      replay.clear();
+      MagicalContainer &published = *shadow;
+      publish(std::move(shadow));
+      updateMirror(published, INT_MIN);
+    } catch (...) {
+      {
+        std::lock_guard<std::mutex> failLock(writerMutex);
+        rebuilding = false;
+        replay.clear();
+      }
+      done->set_exception(std::current_exception());
+      return;
+    }
+    done->set_value();
+  });
+  return result;
+}
+
+void ConcurrentMagicalContainer::removeElement(int element) {
+  std::lock_guard<std::mutex> lock(writerMutex);
+  MagicalContainer *latest = current.load();
+  if (!latest->contains(element)) {
+    throw std::runtime_error("Element not found");
+  }
+  if (rebuilding) {
+    replay.push_back({Mutation::Kind::Remove, element});
+  }
+  auto next = std::make_unique<MagicalContainer>(*latest);
+  next->removeElement(element);
+  MagicalContainer &published = *next;
+  publish(std::move(next));
+  updateMirror(published, element);
+}
+
+int ConcurrentMagicalContainer::size() const {
+  return static_cast<int>(mirrorSize.load(std::memory_order_acquire));
+}
+
+bool ConcurrentMagicalContainer::contains(int element) const {
+  return readOptimistic([element](const std::atomic<int> *values,
+                                  std::size_t count) {
+    std::size_t position = mirrorLowerBound(values, count, element);
+    return position < count &&
+           values[position].load(std::memory_order_acquire) == element;
+  });
+}
+
+std::size_t ConcurrentMagicalContainer::scan(int from, int *out,
+                                             std::size_t max) const {
+  return readOptimistic([from, out, max](const std::atomic<int> *values,
+                                         std::size_t count) {
+    std::size_t position = mirrorLowerBound(values, count, from);
+    std::size_t copied = 0;
+    for (; copied < max && position + copied < count; ++copied) {
+      out[copied] = values[position + copied].load(std::memory_order_acquire);
+    }
+    return copied;
+  });
+}
+
+ConcurrentMagicalContainer::ReadGuard ConcurrentMagicalContainer::read() {
+  return ReadGuard(*this);
+}
+
+std::size_t ConcurrentMagicalContainer::retiredVersions() {
+  std::lock_guard<std::mutex> lock(writerMutex);
+  reclaim();
+  return retired.size();
+}
+
+// ReadGuard
+ConcurrentMagicalContainer::ReadGuard::ReadGuard(
+    ConcurrentMagicalContainer &cont)
+    : owner(&cont), slot(cont.acquireSlot()), version(nullptr) {
+  // Announce the epoch before loading the pointer, so a writer that retires
+  // this version afterwards sees the announcement
+  owner->readers[slot].epoch.store(owner->globalEpoch.load());
+  version = owner->current.load();
+}
+
+ConcurrentMagicalContainer::ReadGuard::ReadGuard(ReadGuard &&other) noexcept
+    : owner(other.owner), slot(other.slot), version(other.version) {
+  other.owner = nullptr;
+}
+
+ConcurrentMagicalContainer::ReadGuard::~ReadGuard() {
+  if (owner != nullptr) {
+    owner->releaseSlot(slot);
+  }
+}
+
+MagicalContainer &ConcurrentMagicalContainer::ReadGuard::operator*() const {
+  return *version;
+}
+
+MagicalContainer *ConcurrentMagicalContainer::ReadGuard::operator->() const {
+  return version;
+}
+
+} // namespace ariel
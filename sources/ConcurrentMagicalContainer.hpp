@@ -0,0 +1,148 @@
+#ifndef CONCURRENTMAGICALCONTAINER_HPP
+#define CONCURRENTMAGICALCONTAINER_HPP
+
+#include "MagicalContainer.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ariel {
+
+// MagicalContainer shared by one or more writers and many readers. Readers
+// pin the currently published version with a ReadGuard and iterate it without
+// locks; writers copy the current version, apply their change and publish the
+// copy. Old versions are reclaimed once no reader that could still see them
+// remains (epoch-based reclamation).
+//
+// size(), contains() and scan() skip the guard: they read a seqlock-protected
+// mirror of the elements and retry if a writer was active meanwhile, so they
+// never write to memory shared with other readers.
+class ConcurrentMagicalContainer {
+public:
+  static constexpr std::size_t MAX_READERS = 128;
+
+  struct Mutation {
+    enum class Kind { Add, Remove };
+    Kind kind;
+    int element;
+  };
+
+private:
+  static constexpr std::uint64_t IDLE = ~std::uint64_t{0};
+
+  struct alignas(64) ReaderSlot {
+    std::atomic<std::uint64_t> epoch{IDLE};
+    std::atomic<bool> taken{false};
+  };
+
+  std::array<ReaderSlot, MAX_READERS> readers;
+  std::atomic<MagicalContainer *> current;
+  std::atomic<std::uint64_t> globalEpoch{1};
+
+  // Writer side
+  std::mutex writerMutex;
+  std::vector<std::pair<std::uint64_t, std::unique_ptr<MagicalContainer>>>
+      retired;
+
+  // Background rebuild: writes are logged for replay while one runs
+  bool rebuilding = false;
+  std::vector<Mutation> replay;
+  std::thread rebuilder;
+
+  // Seqlock mirror. Buffers are only replaced when growing, and replaced ones
+  // stay allocated so a reader racing a resize still reads valid memory.
+  struct MirrorBuffer {
+    std::unique_ptr<std::atomic<int>[]> values;
+    std::size_t capacity;
+  };
+  std::atomic<std::uint64_t> sequence{0};
+  std::atomic<MirrorBuffer *> mirror{nullptr};
+  std::atomic<std::size_t> mirrorSize{0};
+  std::vector<std::unique_ptr<MirrorBuffer>> mirrorBuffers;
+
+  void updateMirror(MagicalContainer &version, int changed);
+  template <typename Read> auto readOptimistic(Read read) const;
+
+  std::size_t acquireSlot();
+  void releaseSlot(std::size_t slot);
+  void publish(std::unique_ptr<MagicalContainer> next);
+  void reclaim();
+
+  // Applies the net effect of mutations to version with one bulk removal and
+  // one bulk merge; returns the smallest element that changed, INT_MAX if
+  // none did
+  static int applyNetEffect(MagicalContainer &version,
+                            std::span<const Mutation> mutations,
+                            std::vector<bool> *succeeded);
+
+public:
+  // Pins the version published when it was created. The version is never
+  // modified; readers must only use its const members and iterators.
+  class ReadGuard {
+  private:
+    ConcurrentMagicalContainer *owner;
+    std::size_t slot;
+    MagicalContainer *version;
+
+  public:
+    explicit ReadGuard(ConcurrentMagicalContainer &cont);
+    ReadGuard(ReadGuard &&other) noexcept;
+    ReadGuard(const ReadGuard &) = delete;
+    ReadGuard &operator=(const ReadGuard &) = delete;
+    ReadGuard &operator=(ReadGuard &&) = delete;
+    ~ReadGuard();
+
+    MagicalContainer &operator*() const;
+    MagicalContainer *operator->() const;
+  };
+
+  ConcurrentMagicalContainer();
+  explicit ConcurrentMagicalContainer(const MagicalContainer &initial);
+  ConcurrentMagicalContainer(const ConcurrentMagicalContainer &) = delete;
+  ConcurrentMagicalContainer &
+  operator=(const ConcurrentMagicalContainer &) = delete;
+  ~ConcurrentMagicalContainer();
+
+  void addElement(int element);
+  void removeElement(int element);
+
+  // Adds a batch as a single new version
+  void addElements(std::span<const int> elements);
+
+  // Applies mutations in order as a single new version. For each, reports
+  // whether it succeeded: adds always do, removes only if the element is
+  // present at that point of the sequence.
+  std::vector<bool> applyBatch(std::span<const Mutation> mutations);
+
+  // Rebuilds the container from values (or from its current elements) on a
+  // background thread: sort, dedupe, prime index and lookup index go into a
+  // shadow version while the current one keeps serving readers and writers.
+  // Writes made meanwhile are replayed onto the shadow, which is then
+  // published like any other version. The future is ready once it is.
+  std::future<void> rebuildAsync(std::vector<int> values);
+  std::future<void> rebuildAsync();
+
+  int size() const;
+  bool contains(int element) const;
+
+  // Copies up to max elements >= from, in ascending order, into out
+  std::size_t scan(int from, int *out, std::size_t max) const;
+
+  // Throws if MAX_READERS guards are already alive
+  ReadGuard read();
+
+  // Versions replaced but not yet reclaimed
+  std::size_t retiredVersions();
+};
+
+} // namespace ariel
+
+#endif /* CONCURRENTMAGICALCONTAINER_HPP */
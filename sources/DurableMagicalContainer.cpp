@@ -0,0 +1,250 @@
+#include "DurableMagicalContainer.hpp"
+#include "FileIO.hpp"
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace ariel {
+
+namespace {
+
+constexpr std::uint32_t ADD = 1;
+constexpr std::uint32_t REMOVE = 2;
+
+std::string snapshotPath(const std::string &directory) {
+  return (std::filesystem::path(directory) / "snapshot.bin").string();
+}
+
+std::string logPath(const std::string &directory) {
+  return (std::filesystem::path(directory) / "wal.log").string();
+}
+
+} // namespace
+
+std::uint32_t DurableMagicalContainer::checkOf(std::uint32_t kind,
+                                               std::int32_t element) {
+  std::uint32_t x = (kind * 0x9e3779b9U) ^ static_cast<std::uint32_t>(element);
+  x ^= x >> 16;
+  x *= 0x85ebca6bU;
+  x ^= x >> 13;
+  x *= 0xc2b2ae35U;
+  x ^= x >> 16;
+  return x ^ 0x57414c31U;
+}
+
+DurableMagicalContainer::DurableMagicalContainer(const std::string &directory,
+                                                 bool waitForSync)
+    : directory(directory), waitForSync(waitForSync) {
+  std::filesystem::create_directories(directory);
+  recover();
+  syncer = std::thread([this] { syncLoop(); });
+}
+
+DurableMagicalContainer::~DurableMagicalContainer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  syncer.join();
+  ::close(log);
+}
+
+// Snapshot first, then the intact log records. Replaying a record whose
+// effect the snapshot already holds is harmless: the last record for an
+// element decides whether it is present.
+void DurableMagicalContainer::recover() {
+  if (std::filesystem::exists(snapshotPath(directory))) {
+    MappedMagicalContainer snapshot =
+        MagicalContainer::mapFromFile(snapshotPath(directory));
+    std::vector<int> elements;
+    elements.reserve(static_cast<std::size_t>(snapshot.size()));
+    for (int element : MappedMagicalContainer::AscendingIterator(snapshot)) {
+      elements.push_back(element);
+    }
+    container.addElements(elements);
+  }
+
+  log = ::open(logPath(directory).c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (log < 0) {
+    throw std::runtime_error("Cannot open write-ahead log: " +
+                             logPath(directory));
+  }
+  std::vector<Record> records(
+      static_cast<std::size_t>(std::filesystem::file_size(logPath(directory))) /
+      sizeof(Record));
+  std::size_t bytes = records.size() * sizeof(Record);
+  if (::pread(log, records.data(), bytes, 0) != static_cast<ssize_t>(bytes)) {
+    ::close(log);
+    throw std::runtime_error("Cannot read write-ahead log: " +
+                             logPath(directory));
+  }
+
+  // Reduced to its net effect, then applied as two batches
+  std::unordered_map<int, bool> present; // after the element's last record
+  std::size_t intact = 0;
+  for (const Record &record : records) {
+    if ((record.kind != ADD && record.kind != REMOVE) ||
+        record.check != checkOf(record.kind, record.element))
+      break;
+    present[record.element] = record.kind == ADD;
+    ++intact;
+  }
+  std::vector<int> adds;
+  std::vector<int> removes;
+  for (const auto &[element, added] : present) {
+    if (added) {
+      adds.push_back(element);
+    } else if (container.contains(element)) {
+      removes.push_back(element);
+    }
+  }
+  container.removeElements(removes);
+  container.addElements(adds);
+  // Cut off a torn tail so new records follow the last intact one
+  if (::ftruncate(log, static_cast<off_t>(intact * sizeof(Record))) != 0) {
+    ::close(log);
+    throw std::runtime_error("Cannot truncate write-ahead log: " +
+                             logPath(directory));
+  }
+  logSize = intact * sizeof(Record);
+}
+
+void DurableMagicalContainer::append(std::uint32_t kind, int element,
+                                     std::unique_lock<std::mutex> &lock) {
+  pending.push_back({kind, element, checkOf(kind, element)});
+  ++appended;
+  wake.notify_one();
+  if (waitForSync) {
+    waitDurable(appended, lock);
+  }
+}
+
+void DurableMagicalContainer::waitDurable(std::uint64_t record,
+                                          std::unique_lock<std::mutex> &lock) {
+  synced.wait(lock, [this, record] { return durable >= record || failed; });
+  if (durable < record) {
+    throw std::runtime_error("Cannot write write-ahead log: " +
+                             logPath(directory));
+  }
+}
+
+void DurableMagicalContainer::syncLoop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    wake.wait(lock, [this] { return stopping || !pending.empty(); });
+    if (pending.empty())
+      return; // stopping, and everything is on disk
+
+    std::vector<Record> group;
+    group.swap(pending);
+    const std::uint64_t upTo = appended;
+    const std::size_t durableSize = logSize;
+    lock.unlock();
+
+    bool written = writeAll(log, group.data(), group.size() * sizeof(Record)) &&
+                   ::fdatasync(log) == 0;
+    // A failed write can leave whole records of the group in the log, and a
+    // failed sync can leave all of them to be written back later: cut the
+    // log back to its last durable size before memory forgets them
+    bool cut = !written &&
+               ::ftruncate(log, static_cast<off_t>(durableSize)) == 0 &&
+               ::fdatasync(log) == 0;
+
+    lock.lock();
+    if (written) {
+      durable = upTo;
+      logSize += group.size() * sizeof(Record);
+    } else {
+      failed = true;
+      if (cut) {
+        // Undo, newest first, every change whose record is no longer in
+        // the log. If the cut failed, what reaches disk is unknown, so
+        // memory is left as it is.
+        group.insert(group.end(), pending.begin(), pending.end());
+        for (auto record = group.rbegin(); record != group.rend(); ++record) {
+          if (record->kind == ADD) {
+            container.removeElement(record->element);
+          } else {
+            container.addElement(record->element);
+          }
+        }
+      }
+      pending.clear();
+    }
+    ++syncs;
+    synced.notify_all();
+  }
+}
+
+void DurableMagicalContainer::checkHealthy() const {
+  if (failed) {
+    throw std::runtime_error("Cannot write write-ahead log: " +
+                             logPath(directory));
+  }
+}
+
+void DurableMagicalContainer::addElement(int element) {
+  std::unique_lock<std::mutex> lock(mutex);
+  checkHealthy();
+  if (container.contains(element)) {
+    // Already present, possibly through an add not yet on disk
+    if (waitForSync) {
+      waitDurable(appended, lock);
+    }
+    return;
+  }
+  container.addElement(element);
+  append(ADD, element, lock);
+}
+
+void DurableMagicalContainer::removeElement(int element) {
+  std::unique_lock<std::mutex> lock(mutex);
+  checkHealthy();
+  container.removeElement(element);
+  append(REMOVE, element, lock);
+}
+
+int DurableMagicalContainer::size() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return container.size();
+}
+
+bool DurableMagicalContainer::contains(int element) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return container.contains(element);
+}
+
+void DurableMagicalContainer::sync() {
+  std::unique_lock<std::mutex> lock(mutex);
+  waitDurable(appended, lock);
+}
+
+// The snapshot replaces the old one by rename before the log is emptied, so a
+// crash at any point leaves a state recovery handles
+void DurableMagicalContainer::checkpoint() {
+  std::unique_lock<std::mutex> lock(mutex);
+  waitDurable(appended, lock); // the syncer is idle from here on
+  container.save(snapshotPath(directory));
+  int folder = ::open(directory.c_str(), O_RDONLY);
+  bool renamed = folder >= 0 && ::fsync(folder) == 0;
+  if (folder >= 0) {
+    ::close(folder);
+  }
+  if (!renamed || ::ftruncate(log, 0) != 0 || ::fdatasync(log) != 0) {
+    throw std::runtime_error("Cannot checkpoint: " + directory);
+  }
+  logSize = 0;
+}
+
+std::size_t DurableMagicalContainer::syncCount() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return syncs;
+}
+
+MagicalContainer &DurableMagicalContainer::contents() { return container; }
+
+} // namespace ariel
@@ -0,0 +1,93 @@
+#ifndef DURABLEMAGICALCONTAINER_HPP
+#define DURABLEMAGICALCONTAINER_HPP
+
+#include "MagicalContainer.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ariel {
+
+// MagicalContainer whose adds and removes survive a crash. The directory holds
+// the last checkpoint (a snapshot file, see MappedMagicalContainer.hpp) and a
+// write-ahead log of the mutations since. Opening the directory loads the
+// snapshot and replays the log; a record torn by a crash ends the replay and
+// is cut off.
+//
+// A background thread writes the log: it takes every record appended since
+// its last write and makes them durable with one fdatasync (group commit), so
+// threads mutating concurrently share the cost of a sync.
+class DurableMagicalContainer {
+private:
+  struct Record {
+    std::uint32_t kind; // 1 add, 2 remove
+    std::int32_t element;
+    std::uint32_t check; // detects torn or zeroed records
+  };
+
+  static std::uint32_t checkOf(std::uint32_t kind, std::int32_t element);
+
+  const std::string directory;
+  const bool waitForSync;
+  MagicalContainer container;
+  int log = -1;
+
+  std::mutex mutex; // guards everything below and container
+  std::condition_variable wake;
+  std::condition_variable synced;
+  std::vector<Record> pending;
+  std::uint64_t appended = 0; // records appended to pending, ever
+  std::uint64_t durable = 0;  // records known to be on disk
+  std::size_t logSize = 0;    // bytes of the log known to be on disk
+  std::size_t syncs = 0;
+  bool failed = false;
+  bool stopping = false;
+  std::thread syncer;
+
+  void recover();
+  void append(std::uint32_t kind, int element,
+              std::unique_lock<std::mutex> &lock);
+  void waitDurable(std::uint64_t record, std::unique_lock<std::mutex> &lock);
+  void checkHealthy() const; // throws once a group commit has failed
+  void syncLoop();
+
+public:
+  // Opens or creates the directory and recovers its contents. With
+  // waitForSync a mutation returns once it is on disk; without, it returns at
+  // once and reaches disk with the next group commit (see sync()).
+  explicit DurableMagicalContainer(const std::string &directory,
+                                   bool waitForSync = true);
+  DurableMagicalContainer(const DurableMagicalContainer &) = delete;
+  DurableMagicalContainer &operator=(const DurableMagicalContainer &) = delete;
+  ~DurableMagicalContainer(); // syncs what is still pending
+
+  // If a group commit fails, the log is cut back to its last durable size and
+  // the changes it and later pending records carried are undone; if the cut
+  // fails too, memory keeps them. From then on these throw without changing
+  // anything.
+  void addElement(int element);
+  void removeElement(int element); // throws, without logging, if missing
+  int size();
+  bool contains(int element);
+
+  // Returns once every mutation made before the call is on disk
+  void sync();
+
+  // Writes a snapshot and empties the log, so recovery has less to replay
+  void checkpoint();
+
+  // Group commits (fdatasync calls) so far
+  std::size_t syncCount();
+
+  // The in-memory container, for iteration. Not while writers are active,
+  // and changes made through it are not logged.
+  MagicalContainer &contents();
+};
+
+} // namespace ariel
+
+#endif /* DURABLEMAGICALCONTAINER_HPP */
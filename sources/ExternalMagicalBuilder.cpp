@@ -0,0 +1,223 @@
+#include "ExternalMagicalBuilder.hpp"
+#include "MagicalContainer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+namespace ariel {
+
+namespace {
+
+// Values per run read buffer; large enough that reads stay sequential
+constexpr std::size_t MERGE_BLOCK = std::size_t{1} << 14;
+
+class RunReader {
+private:
+  std::ifstream in;
+  std::vector<int> block;
+  std::size_t at = 0;
+  std::size_t filled = 0;
+
+public:
+  explicit RunReader(const std::string &path)
+      : in(path, std::ios::binary), block(MERGE_BLOCK) {
+    if (!in) {
+      throw std::runtime_error("Cannot read run: " + path);
+    }
+  }
+
+  bool next(int &value) {
+    if (at == filled) {
+      in.read(reinterpret_cast<char *>(block.data()),
+              static_cast<std::streamsize>(block.size() * sizeof(int)));
+      filled = static_cast<std::size_t>(in.gcount()) / sizeof(int);
+      at = 0;
+      if (filled == 0)
+        return false;
+    }
+    value = block[at++];
+    return true;
+  }
+};
+
+class RunWriter {
+private:
+  std::string path;
+  std::ofstream out;
+  std::vector<int> block;
+
+public:
+  explicit RunWriter(const std::string &path)
+      : path(path), out(path, std::ios::binary | std::ios::trunc) {
+    if (!out) {
+      throw std::runtime_error("Cannot write run: " + path);
+    }
+    block.reserve(MERGE_BLOCK);
+  }
+
+  void add(int value) {
+    block.push_back(value);
+    if (block.size() == MERGE_BLOCK) {
+      flush();
+    }
+  }
+
+  void flush() {
+    out.write(reinterpret_cast<const char *>(block.data()),
+              static_cast<std::streamsize>(block.size() * sizeof(int)));
+    block.clear();
+    if (!out) {
+      throw std::runtime_error("Cannot write run: " + path);
+    }
+  }
+};
+
+// k-way merge of sorted runs; emit sees each distinct value once, ascending
+template <typename Emit>
+void mergeRuns(const std::vector<std::string> &paths, Emit emit) {
+  std::vector<RunReader> readers;
+  readers.reserve(paths.size());
+  using Head = std::pair<int, std::size_t>; // value, reader
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+  for (const std::string &path : paths) {
+    readers.emplace_back(path);
+    int value = 0;
+    if (readers.back().next(value)) {
+      heads.emplace(value, readers.size() - 1);
+    }
+  }
+
+  bool any = false;
+  int last = 0;
+  while (!heads.empty()) {
+    auto [value, reader] = heads.top();
+    heads.pop();
+    if (!any || value != last) {
+      emit(value);
+      any = true;
+      last = value;
+    }
+    if (readers[reader].next(value)) {
+      heads.emplace(value, reader);
+    }
+  }
+}
+
+} // namespace
+
+ExternalMagicalBuilder::ExternalMagicalBuilder(const std::string &outputPath,
+                                               std::size_t memoryBudget,
+                                               const std::string &runDirectory)
+    : outputPath(outputPath),
+      runPrefix(runDirectory.empty()
+                    ? outputPath
+                    : (std::filesystem::path(runDirectory) /
+                       std::filesystem::path(outputPath).filename())
+                          .string()),
+      memoryBudget(std::max(memoryBudget, MIN_BUDGET)) {}
+
+ExternalMagicalBuilder::~ExternalMagicalBuilder() {
+  for (const std::string &run : runs) {
+    std::remove(run.c_str());
+  }
+}
+
+std::size_t ExternalMagicalBuilder::mergeBufferValues() const {
+  return MERGE_BLOCK;
+}
+
+std::size_t ExternalMagicalBuilder::fanIn() const {
+  return std::max<std::size_t>(
+      2, (memoryBudget - WRITER_RESERVE) / (mergeBufferValues() * sizeof(int)));
+}
+
+std::string ExternalMagicalBuilder::nextRunPath() {
+  return runPrefix + ".run" + std::to_string(runsMade++);
+}
+
+void ExternalMagicalBuilder::add(int value) {
+  if (buffer.capacity() == 0) {
+    // Never regrown past it
+    buffer.reserve((memoryBudget - WRITER_RESERVE) / sizeof(int));
+  }
+  buffer.push_back(value);
+  if (buffer.size() == buffer.capacity()) {
+    spill();
+  }
+}
+
+void ExternalMagicalBuilder::add(std::span<const int> values) {
+  for (int value : values) {
+    add(value);
+  }
+}
+
+void ExternalMagicalBuilder::spill() {
+  std::sort(buffer.begin(), buffer.end());
+  buffer.erase(std::unique(buffer.begin(), buffer.end()), buffer.end());
+  std::string path = nextRunPath();
+  runs.push_back(path);
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(buffer.data()),
+            static_cast<std::streamsize>(buffer.size() * sizeof(int)));
+  if (!out) {
+    throw std::runtime_error("Cannot write run: " + path);
+  }
+  buffer.clear();
+}
+
+std::size_t ExternalMagicalBuilder::runCount() const { return runsMade; }
+
+MappedMagicalContainer ExternalMagicalBuilder::finish() {
+  if (!runs.empty()) {
+    if (!buffer.empty()) {
+      spill();
+    }
+    std::vector<int>().swap(buffer); // the merge gets the whole budget
+
+    // Merge groups into longer runs until one merge can read them all
+    while (runs.size() > fanIn()) {
+      std::vector<std::string> group(
+          runs.begin(), runs.begin() + static_cast<std::ptrdiff_t>(fanIn()));
+      std::string path = nextRunPath();
+      {
+        RunWriter merged(path);
+        mergeRuns(group, [&merged](int value) { merged.add(value); });
+        merged.flush();
+      }
+      for (const std::string &run : group) {
+        std::remove(run.c_str());
+      }
+      runs.erase(runs.begin(),
+                 runs.begin() + static_cast<std::ptrdiff_t>(group.size()));
+      runs.push_back(path);
+    }
+  }
+
+  // Made only now, so on the runs path its buffers never sit beside a full
+  // value buffer; on the in-memory path the buffer left it WRITER_RESERVE
+  MappedMagicalContainer::Writer writer(outputPath);
+  auto write = [&writer](int value) { writer.add(value, isPrime(value)); };
+  if (runs.empty()) {
+    std::sort(buffer.begin(), buffer.end());
+    buffer.erase(std::unique(buffer.begin(), buffer.end()), buffer.end());
+    std::for_each(buffer.begin(), buffer.end(), write);
+  } else {
+    mergeRuns(runs, write);
+  }
+  writer.finish();
+
+  for (const std::string &run : runs) {
+    std::remove(run.c_str());
+  }
+  runs.clear();
+  std::vector<int>().swap(buffer);
+  return MappedMagicalContainer(outputPath);
+}
+
+} // namespace ariel
@@ -0,0 +1,66 @@
+#ifndef EXTERNALMAGICALBUILDER_HPP
+#define EXTERNALMAGICALBUILDER_HPP
+
+#include "MappedMagicalContainer.hpp"
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ariel {
+
+// Builds a snapshot file (see MappedMagicalContainer.hpp) from more integers
+// than fit in memory. Values are collected into a buffer; each time it fills
+// it is sorted, deduplicated and spilled to disk as a run. finish() merges
+// the runs k ways, dropping duplicates and classifying primes, and writes the
+// snapshot, which is then mapped for iteration.
+//
+// Buffers, run readers and the snapshot writer together stay within
+// memoryBudget bytes; with more runs than budget for their read buffers, the
+// runs are first merged in groups into longer runs.
+class ExternalMagicalBuilder {
+public:
+  static constexpr std::size_t MIN_BUDGET = std::size_t{1} << 20;
+  // Part of the budget kept for the snapshot writer and the merge heap; the
+  // value buffer gets the rest
+  static constexpr std::size_t WRITER_RESERVE = std::size_t{1} << 18;
+
+private:
+  const std::string outputPath;
+  const std::string runPrefix;
+  const std::size_t memoryBudget;
+  std::vector<int> buffer;
+  std::vector<std::string> runs;
+  std::size_t runsMade = 0;
+
+  void spill();
+  std::string nextRunPath();
+
+  // Read buffer per run, and how many runs one merge may read at once
+  std::size_t mergeBufferValues() const;
+  std::size_t fanIn() const;
+
+public:
+  // Runs go to runDirectory, or next to outputPath if empty. The budget is
+  // raised to MIN_BUDGET if lower.
+  explicit ExternalMagicalBuilder(const std::string &outputPath,
+                                  std::size_t memoryBudget = std::size_t{256}
+                                                             << 20,
+                                  const std::string &runDirectory = "");
+  ExternalMagicalBuilder(const ExternalMagicalBuilder &) = delete;
+  ExternalMagicalBuilder &operator=(const ExternalMagicalBuilder &) = delete;
+  ~ExternalMagicalBuilder(); // removes leftover runs
+
+  void add(int value);
+  void add(std::span<const int> values);
+
+  // Runs spilled so far
+  std::size_t runCount() const;
+
+  // Writes outputPath and maps it
+  MappedMagicalContainer finish();
+};
+
+} // namespace ariel
+
+#endif /* EXTERNALMAGICALBUILDER_HPP */
@@ -0,0 +1,47 @@
+#include "EytzingerIndex.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace ariel {
+
+// In-order walk of the implicit tree hands out the sorted values
+std::size_t EytzingerIndex::fill(const std::vector<int> &sorted,
+                                 std::size_t next, std::size_t node) {
+  if (node < tree.size()) {
+    next = fill(sorted, next, 2 * node);
+    tree[node] = sorted[next];
+    ranks[node] = static_cast<std::uint32_t>(next);
+    ++next;
+    next = fill(sorted, next, 2 * node + 1);
+  }
+  return next;
+}
+
+void EytzingerIndex::build(const std::vector<int> &sorted) {
+  tree.assign(sorted.size() + 1, 0);
+  ranks.assign(sorted.size() + 1, static_cast<std::uint32_t>(sorted.size()));
+  fill(sorted, 0, 1);
+  stale = false;
+}
+
+void EytzingerIndex::invalidate() { stale = true; }
+
+bool EytzingerIndex::isStale() const { return stale; }
+
+std::size_t EytzingerIndex::lowerBound(int value) const {
+  if (tree.empty())
+    return 0;
+  const std::size_t n = tree.size() - 1;
+  const int *data = tree.data();
+  std::size_t k = 1;
+  while (k <= n) {
+    // 16 ints per cache line: node 16k is four levels below k
+    __builtin_prefetch(data + std::min(16 * k, n));
+    k = 2 * k + (data[k] < value ? 1U : 0U);
+  }
+  // Undo the trailing right turns plus the final left turn
+  k >>= static_cast<unsigned>(std::countr_one(k)) + 1U;
+  return k == 0 ? n : ranks[k];
+}
+
+} // namespace ariel
@@ -0,0 +1,33 @@
+#ifndef EYTZINGERINDEX_HPP
+#define EYTZINGERINDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ariel {
+
+// Search index over a sorted vector, stored in Eytzinger (BFS) order so the
+// top levels of every search share cache lines. Lookups descend without
+// branches and prefetch the cache line four levels ahead.
+class EytzingerIndex {
+private:
+  std::vector<int> tree;            // 1-based, tree[0] unused
+  std::vector<std::uint32_t> ranks; // position of tree[k] in sorted order
+  bool stale = true;
+
+  std::size_t fill(const std::vector<int> &sorted, std::size_t next,
+                   std::size_t node);
+
+public:
+  void build(const std::vector<int> &sorted);
+  void invalidate();
+  bool isStale() const;
+
+  // Position of the first element >= value in the sorted vector
+  std::size_t lowerBound(int value) const;
+};
+
+} // namespace ariel
+
+#endif /* EYTZINGERINDEX_HPP */
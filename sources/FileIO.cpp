@@ -0,0 +1,21 @@
+#include "FileIO.hpp"
+#include <cerrno>
+#include <unistd.h>
+
+namespace ariel {
+
+bool writeAll(int fd, const void *data, std::size_t size) {
+  const char *bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t written = ::write(fd, bytes, size);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written < 0)
+      return false;
+    bytes += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+} // namespace ariel
@@ -0,0 +1,14 @@
+#ifndef FILEIO_HPP
+#define FILEIO_HPP
+
+#include <cstddef>
+
+namespace ariel {
+
+// Writes all size bytes to fd, looping over short writes and retrying
+// writes interrupted by a signal. False on any other error, errno set.
+bool writeAll(int fd, const void *data, std::size_t size);
+
+} // namespace ariel
+
+#endif /* FILEIO_HPP */
@@ -0,0 +1,269 @@
+#include "FrozenMagicalContainer.hpp"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace ariel {
+
+FrozenMagicalContainer::FrozenMagicalContainer(const MagicalContainer &source)
+    : sortedElements(source.elements().begin(), source.elements().end()),
+      primeElements(source.primes()) {
+  buildHash();
+}
+
+// splitmix64 finalizer over the value and seed
+std::uint64_t FrozenMagicalContainer::hash(int value, std::uint64_t seed) {
+  std::uint64_t x = static_cast<std::uint32_t>(value) +
+                    seed * 0x9E3779B97F4A7C15ULL;
+  x ^= x >> 30U;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27U;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31U;
+  return x;
+}
+
+// Hash-and-displace: keys are grouped into ~n/4 buckets, then buckets are
+// placed largest first, each searching for a seed that sends all of its keys
+// to free slots of the table. A bucket that finds none within
+// MAX_SEED_ATTEMPTS restarts the build with a new bucket seed and a table
+// n/16 slots larger, so the search always ends; free slots hold a key, which
+// only its own position can match
+void FrozenMagicalContainer::buildHash() {
+  const std::size_t n = sortedElements.size();
+  if (n == 0)
+    return;
+
+  std::size_t tableSize = n;
+  for (std::uint64_t round = 0; !placeBuckets(round << 32U, tableSize);
+       ++round) {
+    tableSize += n / 16 + 1;
+  }
+}
+
+bool FrozenMagicalContainer::placeBuckets(std::uint64_t seed,
+                                          std::size_t tableSize) {
+  const std::size_t bucketCount = sortedElements.size() / 4 + 1;
+  std::vector<std::vector<int>> buckets(bucketCount);
+  for (int value : sortedElements) {
+    buckets[hash(value, seed) % bucketCount].push_back(value);
+  }
+  std::vector<std::size_t> order(bucketCount);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t a, std::size_t b) {
+                     return buckets[a].size() > buckets[b].size();
+                   });
+
+  bucketSeed = seed;
+  seeds.assign(bucketCount, 0);
+  slots.assign(tableSize, sortedElements.front());
+  std::vector<bool> used(tableSize, false);
+  std::vector<std::size_t> positions;
+  for (std::size_t bucket : order) {
+    if (buckets[bucket].empty())
+      break;
+    bool placed = false;
+    for (std::uint32_t displacement = 1;
+         !placed && displacement <= MAX_SEED_ATTEMPTS; ++displacement) {
+      positions.clear();
+      placed = true;
+      for (int value : buckets[bucket]) {
+        std::size_t pos = hash(value, displacement) % tableSize;
+        if (used[pos] ||
+            std::find(positions.begin(), positions.end(), pos) !=
+                positions.end()) {
+          placed = false;
+          break;
+        }
+        positions.push_back(pos);
+      }
+      if (placed)
+        seeds[bucket] = displacement;
+    }
+    if (!placed)
+      return false;
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+      used[positions[i]] = true;
+      slots[positions[i]] = buckets[bucket][i];
+    }
+  }
+  return true;
+}
+
+int FrozenMagicalContainer::size() const {
+  return static_cast<int>(sortedElements.size());
+}
+
+bool FrozenMagicalContainer::contains(int element) const {
+  if (slots.empty())
+    return false;
+  std::uint32_t seed = seeds[hash(element, bucketSeed) % seeds.size()];
+  return slots[hash(element, seed) % slots.size()] == element;
+}
+
+std::size_t FrozenMagicalContainer::lowerBound(int element) const {
+  std::size_t length = sortedElements.size();
+  if (length == 0)
+    return 0;
+  const int *base = sortedElements.data();
+  while (length > 1) {
+    std::size_t half = length / 2;
+    base = (base[half - 1] < element) ? base + half : base;
+    length -= half;
+  }
+  return static_cast<std::size_t>(base - sortedElements.data()) +
+         (*base < element ? 1U : 0U);
+}
+
+// AscendingIterator
+FrozenMagicalContainer::AscendingIterator::AscendingIterator(
+    const FrozenMagicalContainer &cont, std::size_t index)
+    : container(&cont), currentIndex(index) {}
+
+bool FrozenMagicalContainer::AscendingIterator::operator==(
+    const AscendingIterator &other) const {
+  return currentIndex == other.currentIndex;
+}
+
+bool FrozenMagicalContainer::AscendingIterator::operator!=(
+    const AscendingIterator &other) const {
+  return !(*this == other);
+}
+
+bool FrozenMagicalContainer::AscendingIterator::operator>(
+    const AscendingIterator &other) const {
+  return currentIndex > other.currentIndex;
+}
+
+bool FrozenMagicalContainer::AscendingIterator::operator<(
+    const AscendingIterator &other) const {
+  return currentIndex < other.currentIndex;
+}
+
+int FrozenMagicalContainer::AscendingIterator::operator*() const {
+  return container->sortedElements.at(currentIndex);
+}
+
+FrozenMagicalContainer::AscendingIterator &
+FrozenMagicalContainer::AscendingIterator::operator++() {
+  if (currentIndex >= container->sortedElements.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++currentIndex;
+  return *this;
+}
+
+FrozenMagicalContainer::AscendingIterator
+FrozenMagicalContainer::AscendingIterator::begin() const {
+  return AscendingIterator(*container, 0);
+}
+
+FrozenMagicalContainer::AscendingIterator
+FrozenMagicalContainer::AscendingIterator::end() const {
+  return AscendingIterator(*container, container->sortedElements.size());
+}
+
+// SideCrossIterator
+FrozenMagicalContainer::SideCrossIterator::SideCrossIterator(
+    const FrozenMagicalContainer &cont, std::size_t index)
+    : container(&cont), currentIndex(index) {}
+
+bool FrozenMagicalContainer::SideCrossIterator::operator==(
+    const SideCrossIterator &other) const {
+  return currentIndex == other.currentIndex;
+}
+
+bool FrozenMagicalContainer::SideCrossIterator::operator!=(
+    const SideCrossIterator &other) const {
+  return !(*this == other);
+}
+
+bool FrozenMagicalContainer::SideCrossIterator::operator>(
+    const SideCrossIterator &other) const {
+  return currentIndex > other.currentIndex;
+}
+
+bool FrozenMagicalContainer::SideCrossIterator::operator<(
+    const SideCrossIterator &other) const {
+  return currentIndex < other.currentIndex;
+}
+
+int FrozenMagicalContainer::SideCrossIterator::operator*() const {
+  const std::vector<int> &elements = container->sortedElements;
+  if (currentIndex >= elements.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  if (currentIndex % 2 == 0)
+    return elements[currentIndex / 2];
+  return elements[elements.size() - 1 - currentIndex / 2];
+}
+
+FrozenMagicalContainer::SideCrossIterator &
+FrozenMagicalContainer::SideCrossIterator::operator++() {
+  if (currentIndex >= container->sortedElements.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++currentIndex;
+  return *this;
+}
+
+FrozenMagicalContainer::SideCrossIterator
+FrozenMagicalContainer::SideCrossIterator::begin() const {
+  return SideCrossIterator(*container, 0);
+}
+
+FrozenMagicalContainer::SideCrossIterator
+FrozenMagicalContainer::SideCrossIterator::end() const {
+  return SideCrossIterator(*container, container->sortedElements.size());
+}
+
+// PrimeIterator
+FrozenMagicalContainer::PrimeIterator::PrimeIterator(
+    const FrozenMagicalContainer &cont, std::size_t index)
+    : container(&cont), currentIndex(index) {}
+
+bool FrozenMagicalContainer::PrimeIterator::operator==(
+    const PrimeIterator &other) const {
+  return currentIndex == other.currentIndex;
+}
+
+bool FrozenMagicalContainer::PrimeIterator::operator!=(
+    const PrimeIterator &other) const {
+  return !(*this == other);
+}
+
+bool FrozenMagicalContainer::PrimeIterator::operator>(
+    const PrimeIterator &other) const {
+  return currentIndex > other.currentIndex;
+}
+
+bool FrozenMagicalContainer::PrimeIterator::operator<(
+    const PrimeIterator &other) const {
+  return currentIndex < other.currentIndex;
+}
+
+int FrozenMagicalContainer::PrimeIterator::operator*() const {
+  return container->primeElements.at(currentIndex);
+}
+
+FrozenMagicalContainer::PrimeIterator &
+FrozenMagicalContainer::PrimeIterator::operator++() {
+  if (currentIndex >= container->primeElements.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++currentIndex;
+  return *this;
+}
+
+FrozenMagicalContainer::PrimeIterator
+FrozenMagicalContainer::PrimeIterator::begin() const {
+  return PrimeIterator(*container, 0);
+}
+
+FrozenMagicalContainer::PrimeIterator
+FrozenMagicalContainer::PrimeIterator::end() const {
+  return PrimeIterator(*container, container->primeElements.size());
+}
+
+} // namespace ariel
@@ -0,0 +1,123 @@
+#ifndef FROZENMAGICALCONTAINER_HPP
+#define FROZENMAGICALCONTAINER_HPP
+
+#include "MagicalContainer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ariel {
+
+// Read-only copy of a MagicalContainer for long read phases. Membership goes
+// through a perfect hash (hash-and-displace), the primes are stored
+// contiguously and ordered searches use a branch-free binary search.
+class FrozenMagicalContainer {
+private:
+  std::vector<int> sortedElements;
+  std::vector<int> primeElements;
+
+  // Perfect hash: bucket -> displacement seed, slot -> key. Minimal unless
+  // the build had to grow the table to place every bucket
+  static constexpr std::uint32_t MAX_SEED_ATTEMPTS = 1U << 16U;
+  std::uint64_t bucketSeed = 0;
+  std::vector<std::uint32_t> seeds;
+  std::vector<int> slots;
+
+  static std::uint64_t hash(int value, std::uint64_t seed);
+  void buildHash();
+  // One build attempt; false if some bucket found no displacement
+  bool placeBuckets(std::uint64_t seed, std::size_t tableSize);
+
+public:
+  explicit FrozenMagicalContainer(const MagicalContainer &source);
+
+  int size() const;
+  bool contains(int element) const;
+
+  // Position of the first element >= element
+  std::size_t lowerBound(int element) const;
+
+  class AscendingIterator {
+  private:
+    const FrozenMagicalContainer *container;
+    std::size_t currentIndex;
+
+  public:
+    // Constructor
+    AscendingIterator(const FrozenMagicalContainer &cont,
+                      std::size_t index = 0);
+
+    // Comparison operators
+    bool operator==(const AscendingIterator &other) const;
+    bool operator!=(const AscendingIterator &other) const;
+    bool operator>(const AscendingIterator &other) const;
+    bool operator<(const AscendingIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    AscendingIterator &operator++();
+
+    // Iterator begin and end functions
+    AscendingIterator begin() const;
+    AscendingIterator end() const;
+  };
+
+  class SideCrossIterator {
+  private:
+    const FrozenMagicalContainer *container;
+    std::size_t currentIndex; // steps taken, alternating front and back
+
+  public:
+    // Constructor
+    SideCrossIterator(const FrozenMagicalContainer &cont,
+                      std::size_t index = 0);
+
+    // Comparison operators
+    bool operator==(const SideCrossIterator &other) const;
+    bool operator!=(const SideCrossIterator &other) const;
+    bool operator>(const SideCrossIterator &other) const;
+    bool operator<(const SideCrossIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    SideCrossIterator &operator++();
+
+    // Iterator begin and end functions
+    SideCrossIterator begin() const;
+    SideCrossIterator end() const;
+  };
+
+  class PrimeIterator {
+  private:
+    const FrozenMagicalContainer *container;
+    std::size_t currentIndex;
+
+  public:
+    // Constructor
+    PrimeIterator(const FrozenMagicalContainer &cont, std::size_t index = 0);
+
+    // Comparison operators
+    bool operator==(const PrimeIterator &other) const;
+    bool operator!=(const PrimeIterator &other) const;
+    bool operator>(const PrimeIterator &other) const;
+    bool operator<(const PrimeIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    PrimeIterator &operator++();
+
+    // Iterator begin and end functions
+    PrimeIterator begin() const;
+    PrimeIterator end() const;
+  };
+};
+
+} // namespace ariel
+
+#endif /* FROZENMAGICALCONTAINER_HPP */
@@ -0,0 +1,80 @@
+#include "LearnedIndex.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace ariel {
+
+LearnedIndex::LearnedIndex(std::size_t epsilon) : epsilon(epsilon) {}
+
+// Shrinking cone: a segment grows while some slope through its first point
+// keeps every point within epsilon
+void LearnedIndex::build(const std::vector<int> &sorted) {
+  segments.clear();
+  count = sorted.size();
+  stale = false;
+  if (count == 0)
+    return;
+
+  const auto eps = static_cast<double>(epsilon);
+  std::size_t start = 0;
+  double low = 0;
+  double high = INFINITY;
+  for (std::size_t i = 1; i < count; ++i) {
+    double dx = static_cast<double>(sorted[i]) - sorted[start];
+    double dy = static_cast<double>(i - start);
+    double newLow = std::max(low, (dy - eps) / dx);
+    double newHigh = std::min(high, (dy + eps) / dx);
+    if (newLow > newHigh) {
+      double slope = std::isinf(high) ? low : (low + high) / 2;
+      segments.push_back({sorted[start], slope, start});
+      start = i;
+      low = 0;
+      high = INFINITY;
+    } else {
+      low = newLow;
+      high = newHigh;
+    }
+  }
+  double slope = std::isinf(high) ? low : (low + high) / 2;
+  segments.push_back({sorted[start], slope, start});
+}
+
+void LearnedIndex::invalidate() { stale = true; }
+
+bool LearnedIndex::isStale() const { return stale; }
+
+std::size_t LearnedIndex::segmentCount() const { return segments.size(); }
+
+std::size_t LearnedIndex::lowerBound(const std::vector<int> &sorted,
+                                     int value) const {
+  if (segments.empty() || value <= segments.front().firstKey)
+    return 0;
+
+  auto segment = std::upper_bound(
+      segments.begin(), segments.end(), value,
+      [](int v, const Segment &s) { return v < s.firstKey; });
+  --segment;
+  double predicted =
+      static_cast<double>(segment->start) +
+      segment->slope * (static_cast<double>(value) - segment->firstKey);
+  predicted = std::clamp(predicted, 0.0, static_cast<double>(count));
+
+  auto guess = static_cast<std::size_t>(predicted);
+  std::size_t low = guess > epsilon + 1 ? guess - epsilon - 1 : 0;
+  std::size_t high = std::min(count, guess + epsilon + 2);
+  auto first = sorted.begin();
+  auto found = std::lower_bound(first + static_cast<std::ptrdiff_t>(low),
+                                first + static_cast<std::ptrdiff_t>(high),
+                                value);
+  auto position = static_cast<std::size_t>(found - first);
+
+  // Values between two segments can fall outside the window
+  bool leftOk = position != low || low == 0 || sorted[low - 1] < value;
+  bool rightOk = position != high || high == count || sorted[high] >= value;
+  if (leftOk && rightOk)
+    return position;
+  return static_cast<std::size_t>(
+      std::lower_bound(sorted.begin(), sorted.end(), value) - first);
+}
+
+} // namespace ariel
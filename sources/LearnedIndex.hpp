@@ -0,0 +1,40 @@
+#ifndef LEARNEDINDEX_HPP
+#define LEARNEDINDEX_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace ariel {
+
+// Piecewise-linear model of value -> position over a sorted vector. Each
+// segment predicts a position within epsilon of the true one, so a lookup is
+// a segment search plus a lower_bound over a 2*epsilon window.
+class LearnedIndex {
+private:
+  struct Segment {
+    int firstKey;
+    double slope;
+    std::size_t start;
+  };
+
+  std::vector<Segment> segments;
+  std::size_t epsilon;
+  std::size_t count = 0;
+  bool stale = true;
+
+public:
+  explicit LearnedIndex(std::size_t epsilon = 32);
+
+  void build(const std::vector<int> &sorted);
+  void invalidate();
+  bool isStale() const;
+  std::size_t segmentCount() const;
+
+  // Position of the first element >= value; sorted must be the vector the
+  // model was built from
+  std::size_t lowerBound(const std::vector<int> &sorted, int value) const;
+};
+
+} // namespace ariel
+
+#endif /* LEARNEDINDEX_HPP */
@@ -3,9 +3,81 @@
 #include <cmath>
 #include <cstdint>
 #include <iostream>
+#include <thread>
 
 namespace ariel {
 
+namespace {
+
+// Below this many values per worker, extra threads cost more than they save
+constexpr std::size_t PARALLEL_GRAIN = std::size_t{1} << 14;
+
+// Splits [0, count) into parts contiguous ranges and runs
+// work(part, begin, end) for each on its own thread
+template <typename Work>
+void forEachPart(std::size_t parts, std::size_t count, Work work) {
+  std::vector<std::thread> workers;
+  for (std::size_t part = 1; part < parts; ++part) {
+    workers.emplace_back(work, part, count * part / parts,
+                         count * (part + 1) / parts);
+  }
+  work(std::size_t{0}, std::size_t{0}, count / parts);
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+// Exclusive prefix sum in place; returns the total
+std::size_t prefixSum(std::vector<std::size_t> &counts) {
+  std::size_t total = 0;
+  for (std::size_t &count : counts) {
+    std::size_t current = count;
+    count = total;
+    total += current;
+  }
+  return total;
+}
+
+// Boundaries of parts near-equal slices of [first, last); the first
+// (last - first) % parts slices get the extra element
+std::vector<std::size_t> splitPoints(std::size_t first, std::size_t last,
+                                     std::size_t parts) {
+  if (parts == 0) {
+    throw std::runtime_error("Cannot split into zero ranges");
+  }
+  if (last < first) {
+    throw std::runtime_error("Range end precedes its begin");
+  }
+  const std::size_t length = last - first;
+  std::vector<std::size_t> points(parts + 1, first);
+  for (std::size_t part = 0; part < parts; ++part) {
+    points[part + 1] =
+        points[part] + length / parts + (part < length % parts ? 1U : 0U);
+  }
+  return points;
+}
+
+// Index moved by offset, which must stay within [0, limit]
+std::size_t offsetIndex(std::size_t index, std::ptrdiff_t offset,
+                        std::size_t limit) {
+  std::ptrdiff_t target = static_cast<std::ptrdiff_t>(index) + offset;
+  if (target < 0 || static_cast<std::size_t>(target) > limit) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  return static_cast<std::size_t>(target);
+}
+
+// A default-constructed iterator may take any container; otherwise
+// assignment keeps the container an iterator was made for
+void checkSameContainer(const MagicalContainer *target,
+                        const MagicalContainer *source) {
+  if (target != nullptr && source != nullptr && target != source) {
+    throw std::runtime_error("Iterators belong to different containers");
+  }
+}
+
+} // namespace
+
 // Helper function to check if a number is prime
 bool isPrime(int num) {
   if (num <= 1)
@@ -19,55 +91,443 @@ bool isPrime(int num) {
   return true;
 }
 
-void MagicalContainer::addElement(int element) {
-  for (int element_ : sortedElements) {
-    if (element_ == element)
-      return;
+MagicalContainer::MagicalContainer(const MagicalContainer &other)
+    : sortedElements(other.sortedElements), searchIndex(other.searchIndex),
+      learnedIndex(other.learnedIndex), learnedEnabled(other.learnedEnabled),
+      lookupsSinceMutation(other.lookupsSinceMutation),
+      mutationEpoch(other.mutationEpoch), snapshotTable(other.snapshotTable) {
+  relinkPrimes(other.primeIndexes());
+  if (snapshotTable) {
+    SnapshotView::freeze(*snapshotTable); // both containers now hold it
   }
-  sortedElements.push_back(element);
-  std::sort(sortedElements.begin(), sortedElements.end());
+}
+
+MagicalContainer &MagicalContainer::operator=(const MagicalContainer &other) {
+  if (this != &other) {
+    MagicalContainer copy(other);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+// Both sides change contents, so both move to an epoch none of their
+// iterators has seen
+MagicalContainer &MagicalContainer::operator=(MagicalContainer &&other) noexcept {
+  if (this != &other) {
+    const std::uint32_t next = mutationEpoch + 1;
+    sortedElements = std::move(other.sortedElements);
+    prime_pointers = std::move(other.prime_pointers);
+    searchIndex = std::move(other.searchIndex);
+    learnedIndex = std::move(other.learnedIndex);
+    learnedEnabled = other.learnedEnabled;
+    lookupsSinceMutation = other.lookupsSinceMutation;
+    mutationEpoch = next;
+    snapshotTable = std::move(other.snapshotTable);
+    other.sortedElements.clear();
+    other.prime_pointers.clear();
+    other.snapshotTable.reset();
+    other.invalidateIndexes();
+  }
+  return *this;
+}
+
+// A stale index is only rebuilt after a run of lookups with no mutation in
+// between; until then, and so for every lookup made by add or remove, a
+// plain binary search costs O(log n) instead of an O(n) rebuild
+std::size_t MagicalContainer::findPosition(int element) const {
+  const bool stale =
+      learnedEnabled ? learnedIndex.isStale() : searchIndex.isStale();
+  if (stale && ++lookupsSinceMutation >= INDEX_REBUILD_AFTER) {
+    prepareLookups();
+  } else if (stale) {
+    return static_cast<std::size_t>(
+        std::lower_bound(sortedElements.begin(), sortedElements.end(),
+                         element) -
+        sortedElements.begin());
+  }
+  if (learnedEnabled) {
+    return learnedIndex.lowerBound(sortedElements, element);
+  }
+  return searchIndex.lowerBound(element);
+}
+
+// Called on every mutation
+void MagicalContainer::invalidateIndexes() {
+  ++mutationEpoch;
+  searchIndex.invalidate();
+  learnedIndex.invalidate();
+  lookupsSinceMutation = 0;
+}
+
+std::vector<std::size_t> MagicalContainer::primeIndexes() const {
+  std::vector<std::size_t> indexes;
+  indexes.reserve(prime_pointers.size() + 1);
+  for (const int *prime : prime_pointers) {
+    indexes.push_back(static_cast<std::size_t>(prime - sortedElements.data()));
+  }
+  return indexes;
+}
+
+void MagicalContainer::relinkPrimes(const std::vector<std::size_t> &indexes) {
   prime_pointers.clear();
-  for (unsigned long i = 0; i < sortedElements.size(); i++) {
-    if (isPrime(sortedElements.at(i))) {
-      prime_pointers.push_back(&sortedElements.at(i));
-    }
+  for (std::size_t index : indexes) {
+    prime_pointers.push_back(&sortedElements[index]);
+  }
+}
+
+void MagicalContainer::addElement(int element) {
+  std::size_t position = findPosition(element);
+  if (position < sortedElements.size() &&
+      sortedElements[position] == element) {
+    return;
+  }
+
+  std::vector<std::size_t> primes = primeIndexes();
+  auto shifted = std::lower_bound(primes.begin(), primes.end(), position);
+  for (auto it = shifted; it != primes.end(); ++it) {
+    ++*it;
+  }
+  const bool prime = isPrime(element);
+  if (prime) {
+    primes.insert(shifted, position);
+  }
+
+  sortedElements.insert(
+      sortedElements.begin() + static_cast<std::ptrdiff_t>(position), element);
+  invalidateIndexes();
+  relinkPrimes(primes);
+  if (snapshotTable) {
+    SnapshotView::insert(snapshotTable, element, prime);
   }
 }
 
 void MagicalContainer::removeElement(int element) {
-  auto it = std::find(sortedElements.begin(), sortedElements.end(), element);
-  if (it != sortedElements.end()) {
-    sortedElements.erase(it);
-  } else {
+  std::size_t position = findPosition(element);
+  if (position == sortedElements.size() ||
+      sortedElements[position] != element) {
     throw std::runtime_error("Element not found");
   }
+
+  std::vector<std::size_t> primes = primeIndexes();
+  auto shifted = std::lower_bound(primes.begin(), primes.end(), position);
+  if (shifted != primes.end() && *shifted == position) {
+    shifted = primes.erase(shifted);
+  }
+  for (auto it = shifted; it != primes.end(); ++it) {
+    --*it;
+  }
+
+  sortedElements.erase(sortedElements.begin() +
+                       static_cast<std::ptrdiff_t>(position));
+  invalidateIndexes();
+  relinkPrimes(primes);
+  if (snapshotTable) {
+    SnapshotView::erase(snapshotTable, element);
+  }
+}
+
+// Merges the sorted batch into sortedElements; old elements keep their
+// primality from prime_pointers, so only new elements are tested
+void MagicalContainer::addElements(std::span<const int> elements) {
+  std::vector<int> batch(elements.begin(), elements.end());
+  std::sort(batch.begin(), batch.end());
+  batch.erase(std::unique(batch.begin(), batch.end()), batch.end());
+
+  const std::vector<std::size_t> oldPrimes = primeIndexes();
+  std::vector<int> merged;
+  merged.reserve(sortedElements.size() + batch.size());
+  std::vector<std::size_t> primes;
+  primes.reserve(oldPrimes.size());
+
+  std::size_t i = 0;
+  std::size_t j = 0;
+  std::size_t p = 0;
+  while (i < sortedElements.size() || j < batch.size()) {
+    if (j == batch.size() ||
+        (i < sortedElements.size() && sortedElements[i] <= batch[j])) {
+      if (j < batch.size() && sortedElements[i] == batch[j]) {
+        ++j;
+      }
+      if (p < oldPrimes.size() && oldPrimes[p] == i) {
+        primes.push_back(merged.size());
+        ++p;
+      }
+      merged.push_back(sortedElements[i++]);
+    } else {
+      if (isPrime(batch[j])) {
+        primes.push_back(merged.size());
+      }
+      merged.push_back(batch[j++]);
+    }
+  }
+  if (merged.size() == sortedElements.size())
+    return;
+
+  sortedElements.swap(merged);
+  invalidateIndexes();
+  relinkPrimes(primes);
+  snapshotTable.reset();
+}
+
+void MagicalContainer::removeElements(std::span<const int> elements) {
+  std::vector<int> batch(elements.begin(), elements.end());
+  std::sort(batch.begin(), batch.end());
+  batch.erase(std::unique(batch.begin(), batch.end()), batch.end());
+  for (int element : batch) {
+    if (!std::binary_search(sortedElements.begin(), sortedElements.end(),
+                            element)) {
+      throw std::runtime_error("Element not found");
+    }
+  }
+  if (batch.empty())
+    return;
+
+  const std::vector<std::size_t> oldPrimes = primeIndexes();
+  std::vector<int> kept;
+  kept.reserve(sortedElements.size() - batch.size());
+  std::vector<std::size_t> primes;
+  primes.reserve(oldPrimes.size());
+
+  std::size_t j = 0;
+  std::size_t p = 0;
+  for (std::size_t i = 0; i < sortedElements.size(); ++i) {
+    bool prime = p < oldPrimes.size() && oldPrimes[p] == i;
+    p += prime ? 1U : 0U;
+    if (j < batch.size() && sortedElements[i] == batch[j]) {
+      ++j;
+      continue;
+    }
+    if (prime) {
+      primes.push_back(kept.size());
+    }
+    kept.push_back(sortedElements[i]);
+  }
+
+  sortedElements.swap(kept);
+  invalidateIndexes();
+  relinkPrimes(primes);
+  snapshotTable.reset();
 }
 
 int MagicalContainer::size() const { return sortedElements.size(); }
 
+bool MagicalContainer::contains(int element) const {
+  std::size_t position = findPosition(element);
+  return position < sortedElements.size() &&
+         sortedElements[position] == element;
+}
+
+std::size_t MagicalContainer::primeCount() const {
+  return prime_pointers.size();
+}
+
+std::span<const int> MagicalContainer::elements() const {
+  return sortedElements;
+}
+
+std::vector<int> MagicalContainer::primes() const {
+  std::vector<int> values;
+  values.reserve(prime_pointers.size());
+  for (const int *prime : prime_pointers) {
+    values.push_back(*prime);
+  }
+  return values;
+}
+
+void MagicalContainer::enableLearnedIndex(std::size_t epsilon) {
+  learnedIndex = LearnedIndex(epsilon);
+  learnedEnabled = true;
+  lookupsSinceMutation = 0;
+}
+
+void MagicalContainer::prepareLookups() const {
+  if (learnedEnabled) {
+    if (learnedIndex.isStale()) {
+      learnedIndex.build(sortedElements);
+    }
+  } else if (searchIndex.isStale()) {
+    searchIndex.build(sortedElements);
+  }
+}
+
+CompressedSnapshot MagicalContainer::freeze() const {
+  return CompressedSnapshot(sortedElements, primeIndexes());
+}
+
+void MagicalContainer::save(const std::string &path) const {
+  MappedMagicalContainer::Writer writer(path);
+  std::size_t p = 0;
+  for (const int &element : sortedElements) {
+    bool prime = p < prime_pointers.size() && prime_pointers[p] == &element;
+    p += prime ? 1U : 0U;
+    writer.add(element, prime);
+  }
+  writer.finish();
+}
+
+MappedMagicalContainer MagicalContainer::mapFromFile(const std::string &path) {
+  return MappedMagicalContainer(path);
+}
+
+SnapshotView MagicalContainer::snapshot() const {
+  if (!snapshotTable) {
+    snapshotTable = SnapshotView::build(sortedElements, prime_pointers);
+  }
+  SnapshotView::freeze(*snapshotTable);
+  return SnapshotView(snapshotTable);
+}
+
+// Sorts each part on its own thread, then merges neighbouring runs pairwise,
+// one thread per merge, until one run is left. Dedupe and prime
+// classification are chunked passes whose per-part counts are turned into
+// output offsets with a prefix sum.
+MagicalContainer MagicalContainer::buildParallel(std::span<const int> values,
+                                                 unsigned threads) {
+  std::size_t parts =
+      threads != 0 ? threads : std::max(1U, std::thread::hardware_concurrency());
+  parts = std::max<std::size_t>(
+      1, std::min(parts, values.size() / PARALLEL_GRAIN));
+
+  std::vector<std::size_t> bounds(parts + 1);
+  for (std::size_t part = 0; part <= parts; ++part) {
+    bounds[part] = values.size() * part / parts;
+  }
+
+  std::vector<int> runs(values.size());
+  forEachPart(parts, values.size(),
+              [&](std::size_t, std::size_t begin, std::size_t end) {
+                std::copy(values.begin() + static_cast<std::ptrdiff_t>(begin),
+                          values.begin() + static_cast<std::ptrdiff_t>(end),
+                          runs.begin() + static_cast<std::ptrdiff_t>(begin));
+                std::sort(runs.begin() + static_cast<std::ptrdiff_t>(begin),
+                          runs.begin() + static_cast<std::ptrdiff_t>(end));
+              });
+
+  std::vector<int> merged(runs.size());
+  for (std::size_t width = 1; width < parts; width *= 2) {
+    std::vector<std::thread> workers;
+    for (std::size_t first = 0; first < parts; first += 2 * width) {
+      auto at = [&bounds, parts](std::size_t part) {
+        return static_cast<std::ptrdiff_t>(bounds[std::min(part, parts)]);
+      };
+      workers.emplace_back([&, first, at] {
+        std::merge(runs.begin() + at(first), runs.begin() + at(first + width),
+                   runs.begin() + at(first + width),
+                   runs.begin() + at(first + 2 * width),
+                   merged.begin() + at(first));
+      });
+    }
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+    runs.swap(merged);
+  }
+  std::vector<int>().swap(merged);
+
+  // Dedupe: an element survives if it differs from its predecessor
+  std::vector<std::size_t> offsets(parts);
+  forEachPart(parts, runs.size(),
+              [&](std::size_t part, std::size_t begin, std::size_t end) {
+                std::size_t kept = 0;
+                for (std::size_t i = begin; i < end; ++i) {
+                  kept += (i == 0 || runs[i] != runs[i - 1]) ? 1U : 0U;
+                }
+                offsets[part] = kept;
+              });
+  MagicalContainer container;
+  container.sortedElements.resize(prefixSum(offsets));
+  forEachPart(parts, runs.size(),
+              [&](std::size_t part, std::size_t begin, std::size_t end) {
+                std::size_t out = offsets[part];
+                for (std::size_t i = begin; i < end; ++i) {
+                  if (i == 0 || runs[i] != runs[i - 1]) {
+                    container.sortedElements[out++] = runs[i];
+                  }
+                }
+              });
+  std::vector<int>().swap(runs);
+
+  // Primes: classify per part, then place each part's pointers at its offset
+  std::vector<int> &elements = container.sortedElements;
+  std::vector<std::vector<std::size_t>> found(parts);
+  forEachPart(parts, elements.size(),
+              [&](std::size_t part, std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; ++i) {
+                  if (isPrime(elements[i])) {
+                    found[part].push_back(i);
+                  }
+                }
+                offsets[part] = found[part].size();
+              });
+  container.prime_pointers.resize(prefixSum(offsets));
+  forEachPart(parts, elements.size(),
+              [&](std::size_t part, std::size_t, std::size_t) {
+                std::size_t out = offsets[part];
+                for (std::size_t index : found[part]) {
+                  container.prime_pointers[out++] = &elements[index];
+                }
+              });
+  return container;
+}
+
 // AscendingIterator
+MagicalContainer::AscendingIterator::AscendingIterator()
+    : container(nullptr), currentIndex(0) {}
+
 MagicalContainer::AscendingIterator::AscendingIterator(
     const AscendingIterator &other)
-    : container(other.container), currentIndex(other.currentIndex) {}
+    : container(other.container), currentIndex(other.currentIndex),
+      epoch(other.epoch), anchor(other.anchor), anchored(other.anchored) {}
 
 MagicalContainer::AscendingIterator::~AscendingIterator() {}
 
+// Records the container's epoch and the value under the cursor, which is
+// where the cursor belongs after any later mutation
+void MagicalContainer::AscendingIterator::remember() const {
+  epoch = container->mutationEpoch;
+  anchored = currentIndex < container->sortedElements.size();
+  if (anchored) {
+    anchor = container->sortedElements[currentIndex];
+  }
+}
+
+// The cursor, re-sought by value first if the container changed: inserts
+// before it no longer shift it onto a repeated element, and removing its
+// element moves it onto the next one
+std::size_t MagicalContainer::AscendingIterator::index() const {
+  if (container != nullptr && epoch != container->mutationEpoch) {
+    currentIndex = anchored ? container->findPosition(anchor)
+                            : container->sortedElements.size();
+    remember();
+  }
+  return currentIndex;
+}
+
 MagicalContainer::AscendingIterator::AscendingIterator(MagicalContainer &cont,
                                                        std::size_t index)
-    : container(cont), currentIndex(index) {}
+    : container(&cont), currentIndex(index) {
+  remember();
+}
 
 MagicalContainer::AscendingIterator &
 MagicalContainer::AscendingIterator::operator=(const AscendingIterator &other) {
-  if (&container != &other.container) {
-    throw std::runtime_error("Iterators belong to different containers");
-  }
+  checkSameContainer(container, other.container);
+  container = other.container;
   currentIndex = other.currentIndex;
+  epoch = other.epoch;
+  anchor = other.anchor;
+  anchored = other.anchored;
   return *this;
 }
 
+MagicalContainer::AscendingIterator &
+MagicalContainer::AscendingIterator::operator=(AscendingIterator &&other) {
+  return *this = other;
+}
+
 bool MagicalContainer::AscendingIterator::operator==(
     const AscendingIterator &other) const {
-  return currentIndex == other.currentIndex;
+  return index() == other.index();
 }
 
 bool MagicalContainer::AscendingIterator::operator!=(
@@ -77,62 +537,165 @@ bool MagicalContainer::AscendingIterator::operator!=(
 
 bool MagicalContainer::AscendingIterator::operator>(
     const AscendingIterator &other) const {
-  return container.sortedElements[currentIndex] >
-         container.sortedElements[other.currentIndex];
+  return index() > other.index();
 }
 
 bool MagicalContainer::AscendingIterator::operator<(
     const AscendingIterator &other) const {
-  return container.sortedElements[currentIndex] <
-         container.sortedElements[other.currentIndex];
+  return index() < other.index();
 }
 
-int MagicalContainer::AscendingIterator::operator*() const {
-  return container.sortedElements[currentIndex];
+bool MagicalContainer::AscendingIterator::operator>=(
+    const AscendingIterator &other) const {
+  return !(*this < other);
+}
+
+bool MagicalContainer::AscendingIterator::operator<=(
+    const AscendingIterator &other) const {
+  return !(*this > other);
+}
+
+const int &MagicalContainer::AscendingIterator::operator*() const {
+  return container->sortedElements[index()];
+}
+
+const int &
+MagicalContainer::AscendingIterator::operator[](difference_type offset) const {
+  return *(*this + offset);
 }
 
 MagicalContainer::AscendingIterator &
 MagicalContainer::AscendingIterator::operator++() {
-  ++currentIndex;
-  if (currentIndex > container.sortedElements.size()) {
+  std::size_t at = index();
+  if (at >= container->sortedElements.size()) {
     throw std::runtime_error("Iterator out of range");
   }
+  currentIndex = at + 1;
+  remember();
   return *this;
 }
 
+MagicalContainer::AscendingIterator
+MagicalContainer::AscendingIterator::operator++(int) {
+  AscendingIterator previous(*this);
+  ++*this;
+  return previous;
+}
+
+MagicalContainer::AscendingIterator &
+MagicalContainer::AscendingIterator::operator--() {
+  return *this -= 1;
+}
+
+MagicalContainer::AscendingIterator
+MagicalContainer::AscendingIterator::operator--(int) {
+  AscendingIterator previous(*this);
+  --*this;
+  return previous;
+}
+
+MagicalContainer::AscendingIterator &
+MagicalContainer::AscendingIterator::operator+=(difference_type offset) {
+  currentIndex = offsetIndex(index(), offset, container->sortedElements.size());
+  remember();
+  return *this;
+}
+
+MagicalContainer::AscendingIterator &
+MagicalContainer::AscendingIterator::operator-=(difference_type offset) {
+  return *this += -offset;
+}
+
+MagicalContainer::AscendingIterator
+MagicalContainer::AscendingIterator::operator+(difference_type offset) const {
+  AscendingIterator moved(*this);
+  return moved += offset;
+}
+
+MagicalContainer::AscendingIterator
+MagicalContainer::AscendingIterator::operator-(difference_type offset) const {
+  AscendingIterator moved(*this);
+  return moved -= offset;
+}
+
+MagicalContainer::AscendingIterator::difference_type
+MagicalContainer::AscendingIterator::operator-(
+    const AscendingIterator &other) const {
+  return static_cast<difference_type>(index()) -
+         static_cast<difference_type>(other.index());
+}
+
 MagicalContainer::AscendingIterator
 MagicalContainer::AscendingIterator::begin() const {
-  return AscendingIterator(container, 0);
+  return AscendingIterator(*container, 0);
 }
 
 MagicalContainer::AscendingIterator
 MagicalContainer::AscendingIterator::end() const {
-  return AscendingIterator(container, (unsigned long)container.size());
+  return AscendingIterator(*container, container->sortedElements.size());
 }
 
-// SideCrossIterator
+std::vector<std::pair<MagicalContainer::AscendingIterator,
+                      MagicalContainer::AscendingIterator>>
+MagicalContainer::AscendingIterator::split(const AscendingIterator &last,
+                                           std::size_t parts) const {
+  if (container != last.container) {
+    throw std::runtime_error("Iterators belong to different containers");
+  }
+  std::vector<std::size_t> points =
+      splitPoints(index(), last.index(), parts);
+  std::vector<std::pair<AscendingIterator, AscendingIterator>> ranges;
+  ranges.reserve(parts);
+  for (std::size_t part = 0; part < parts; ++part) {
+    ranges.emplace_back(AscendingIterator(*container, points[part]),
+                        AscendingIterator(*container, points[part + 1]));
+  }
+  return ranges;
+}
+
+// SideCrossIterator: every operation goes through position(), so random
+// access and plain increments agree on the front/back alternation
+MagicalContainer::SideCrossIterator::SideCrossIterator()
+    : container(nullptr), currentIndex(0), reverse(false), generation(0) {}
+
 MagicalContainer::SideCrossIterator::SideCrossIterator(
     const SideCrossIterator &other)
     : container(other.container), currentIndex(other.currentIndex),
-      reverse(other.reverse) {}
+      reverse(other.reverse), generation(other.generation) {}
 
 MagicalContainer::SideCrossIterator::~SideCrossIterator() {}
 
 MagicalContainer::SideCrossIterator::SideCrossIterator(MagicalContainer &cont,
                                                        std::size_t index,
                                                        bool rev)
-    : container(cont), currentIndex(index), reverse(rev) {}
+    : container(&cont), currentIndex(index), reverse(rev),
+      generation(cont.mutationEpoch) {}
 
 MagicalContainer::SideCrossIterator &
 MagicalContainer::SideCrossIterator::operator=(const SideCrossIterator &other) {
-  if (&container != &other.container) {
-    throw std::runtime_error("Iterators belong to different containers");
-  }
+  checkSameContainer(container, other.container);
+  container = other.container;
   currentIndex = other.currentIndex;
   reverse = other.reverse;
+  generation = other.generation;
   return *this;
 }
 
+MagicalContainer::SideCrossIterator &
+MagicalContainer::SideCrossIterator::operator=(SideCrossIterator &&other) {
+  return *this = other;
+}
+
+std::size_t MagicalContainer::SideCrossIterator::position() const {
+  return 2 * currentIndex + (reverse ? 1U : 0U);
+}
+
+// Position k is the k/2-th element from the front (even k) or back (odd k)
+void MagicalContainer::SideCrossIterator::seek(std::size_t target) {
+  currentIndex = target / 2;
+  reverse = target % 2 == 1;
+}
+
 bool MagicalContainer::SideCrossIterator::operator==(
     const SideCrossIterator &other) const {
   return currentIndex == other.currentIndex && reverse == other.reverse;
@@ -145,74 +708,190 @@ bool MagicalContainer::SideCrossIterator::operator!=(
 
 bool MagicalContainer::SideCrossIterator::operator>(
     const SideCrossIterator &other) const {
-  return (*this).operator*() > (other).operator*();
+  return position() > other.position();
 }
 
 bool MagicalContainer::SideCrossIterator::operator<(
     const SideCrossIterator &other) const {
-  return (*this).operator*() < (other).operator*();
+  return position() < other.position();
+}
+
+bool MagicalContainer::SideCrossIterator::operator>=(
+    const SideCrossIterator &other) const {
+  return !(*this < other);
+}
+
+bool MagicalContainer::SideCrossIterator::operator<=(
+    const SideCrossIterator &other) const {
+  return !(*this > other);
 }
 
-int MagicalContainer::SideCrossIterator::operator*() const {
+const int &MagicalContainer::SideCrossIterator::operator*() const {
+  checkGeneration();
   if (reverse)
     return container
-        .sortedElements[(unsigned long)container.size() - currentIndex - 1];
+        ->sortedElements[container->sortedElements.size() - currentIndex - 1];
   else
-    return container.sortedElements[currentIndex];
+    return container->sortedElements[currentIndex];
+}
+
+const int &
+MagicalContainer::SideCrossIterator::operator[](difference_type offset) const {
+  return *(*this + offset);
 }
 
 MagicalContainer::SideCrossIterator &
 MagicalContainer::SideCrossIterator::operator++() {
-  number_steps++;
-  if (number_steps == container.size() + 1) {
+  checkGeneration();
+  if (position() >= container->sortedElements.size()) {
     throw std::runtime_error("Iterator out of range");
   }
-  if (reverse) {
-    ++currentIndex;
-  }
+  seek(position() + 1);
+  return *this;
+}
+
+MagicalContainer::SideCrossIterator
+MagicalContainer::SideCrossIterator::operator++(int) {
+  SideCrossIterator previous(*this);
+  ++*this;
+  return previous;
+}
+
+MagicalContainer::SideCrossIterator &
+MagicalContainer::SideCrossIterator::operator--() {
+  return *this -= 1;
+}
 
-  reverse = !reverse;
+MagicalContainer::SideCrossIterator
+MagicalContainer::SideCrossIterator::operator--(int) {
+  SideCrossIterator previous(*this);
+  --*this;
+  return previous;
+}
+
+MagicalContainer::SideCrossIterator &
+MagicalContainer::SideCrossIterator::operator+=(difference_type offset) {
+  seek(offsetIndex(position(), offset, container->sortedElements.size()));
   return *this;
 }
 
+MagicalContainer::SideCrossIterator &
+MagicalContainer::SideCrossIterator::operator-=(difference_type offset) {
+  return *this += -offset;
+}
+
+MagicalContainer::SideCrossIterator
+MagicalContainer::SideCrossIterator::operator+(difference_type offset) const {
+  SideCrossIterator moved(*this);
+  return moved += offset;
+}
+
+MagicalContainer::SideCrossIterator
+MagicalContainer::SideCrossIterator::operator-(difference_type offset) const {
+  SideCrossIterator moved(*this);
+  return moved -= offset;
+}
+
+MagicalContainer::SideCrossIterator::difference_type
+MagicalContainer::SideCrossIterator::operator-(
+    const SideCrossIterator &other) const {
+  return static_cast<difference_type>(position()) -
+         static_cast<difference_type>(other.position());
+}
+
 MagicalContainer::SideCrossIterator
 MagicalContainer::SideCrossIterator::begin() const {
-  return SideCrossIterator(container, 0, false);
+  return SideCrossIterator(*container, 0, false);
 }
 
 MagicalContainer::SideCrossIterator
 MagicalContainer::SideCrossIterator::end() const {
-  if (container.sortedElements.size() % 2 == 0) {
-    return SideCrossIterator(container, (container.sortedElements.size() / 2),
-                             false);
-  } else {
-    return SideCrossIterator(container, ((container.sortedElements.size() / 2)),
-                             true);
+  SideCrossIterator last(*container);
+  last.seek(container->sortedElements.size());
+  return last;
+}
+
+// Every sub-range boundary is a side-cross position, so the sub-ranges
+// concatenate to exactly the whole traversal
+std::vector<std::pair<MagicalContainer::SideCrossIterator,
+                      MagicalContainer::SideCrossIterator>>
+MagicalContainer::SideCrossIterator::split(const SideCrossIterator &last,
+                                           std::size_t parts) const {
+  if (container != last.container) {
+    throw std::runtime_error("Iterators belong to different containers");
   }
+  std::vector<std::size_t> points =
+      splitPoints(position(), last.position(), parts);
+  std::vector<std::pair<SideCrossIterator, SideCrossIterator>> ranges;
+  ranges.reserve(parts);
+  for (std::size_t part = 0; part < parts; ++part) {
+    ranges.emplace_back(begin() + static_cast<difference_type>(points[part]),
+                        begin() +
+                            static_cast<difference_type>(points[part + 1]));
+  }
+  return ranges;
 }
 
 // PrimeIterator
+MagicalContainer::PrimeIterator::PrimeIterator()
+    : container(nullptr), currentIndex(0) {}
+
 MagicalContainer::PrimeIterator::PrimeIterator(const PrimeIterator &other)
-    : container(other.container), currentIndex(other.currentIndex) {}
+    : container(other.container), currentIndex(other.currentIndex),
+      epoch(other.epoch), anchor(other.anchor), anchored(other.anchored) {}
 
 MagicalContainer::PrimeIterator::~PrimeIterator() {}
 
+void MagicalContainer::PrimeIterator::remember() const {
+  epoch = container->mutationEpoch;
+  anchored = currentIndex < container->prime_pointers.size();
+  if (anchored) {
+    anchor = *container->prime_pointers[currentIndex];
+  }
+}
+
+// As AscendingIterator::index(); prime_pointers is ordered by value too
+std::size_t MagicalContainer::PrimeIterator::index() const {
+  if (container != nullptr && epoch != container->mutationEpoch) {
+    const std::vector<int *> &primes = container->prime_pointers;
+    currentIndex =
+        anchored ? static_cast<std::size_t>(
+                       std::lower_bound(primes.begin(), primes.end(), anchor,
+                                        [](const int *prime, int value) {
+                                          return *prime < value;
+                                        }) -
+                       primes.begin())
+                 : primes.size();
+    remember();
+  }
+  return currentIndex;
+}
+
 MagicalContainer::PrimeIterator::PrimeIterator(MagicalContainer &cont,
                                                std::size_t index)
-    : container(cont), currentIndex(index) {}
+    : container(&cont), currentIndex(index) {
+  remember();
+}
 
 MagicalContainer::PrimeIterator &
 MagicalContainer::PrimeIterator::operator=(const PrimeIterator &other) {
-  if (&container != &other.container) {
-    throw std::runtime_error("Iterators belong to different containers");
-  }
+  checkSameContainer(container, other.container);
+  container = other.container;
   currentIndex = other.currentIndex;
+  epoch = other.epoch;
+  anchor = other.anchor;
+  anchored = other.anchored;
   return *this;
 }
 
+MagicalContainer::PrimeIterator &
+MagicalContainer::PrimeIterator::operator=(PrimeIterator &&other) {
+  return *this = other;
+}
+
 bool MagicalContainer::PrimeIterator::operator==(
     const PrimeIterator &other) const {
-  return currentIndex == other.currentIndex;
+  return index() == other.index();
 }
 
 bool MagicalContainer::PrimeIterator::operator!=(
@@ -222,36 +901,114 @@ bool MagicalContainer::PrimeIterator::operator!=(
 
 bool MagicalContainer::PrimeIterator::operator>(
     const PrimeIterator &other) const {
-  return currentIndex > other.currentIndex;
+  return index() > other.index();
 }
 
 bool MagicalContainer::PrimeIterator::operator<(
     const PrimeIterator &other) const {
-  return currentIndex < other.currentIndex;
+  return index() < other.index();
+}
+
+bool MagicalContainer::PrimeIterator::operator>=(
+    const PrimeIterator &other) const {
+  return !(*this < other);
+}
+
+bool MagicalContainer::PrimeIterator::operator<=(
+    const PrimeIterator &other) const {
+  return !(*this > other);
 }
 
 int &MagicalContainer::PrimeIterator::operator*() const {
-  return *container.prime_pointers.at(currentIndex);
+  return *container->prime_pointers.at(index());
 }
 
-MagicalContainer::PrimeIterator &MagicalContainer::PrimeIterator::operator++() {
+int &MagicalContainer::PrimeIterator::operator[](difference_type offset) const {
+  return *(*this + offset);
+}
 
-  if (currentIndex >= container.prime_pointers.size()) {
-    throw std::runtime_error("Iterator out of range");
-  }
-  if (*this == end()) {
+MagicalContainer::PrimeIterator &MagicalContainer::PrimeIterator::operator++() {
+  std::size_t at = index();
+  if (at >= container->prime_pointers.size()) {
     throw std::runtime_error("Iterator out of range");
   }
-  currentIndex++;
+  currentIndex = at + 1;
+  remember();
   return *this;
 }
 
+MagicalContainer::PrimeIterator
+MagicalContainer::PrimeIterator::operator++(int) {
+  PrimeIterator previous(*this);
+  ++*this;
+  return previous;
+}
+
+MagicalContainer::PrimeIterator &MagicalContainer::PrimeIterator::operator--() {
+  return *this -= 1;
+}
+
+MagicalContainer::PrimeIterator
+MagicalContainer::PrimeIterator::operator--(int) {
+  PrimeIterator previous(*this);
+  --*this;
+  return previous;
+}
+
+MagicalContainer::PrimeIterator &
+MagicalContainer::PrimeIterator::operator+=(difference_type offset) {
+  currentIndex = offsetIndex(index(), offset, container->prime_pointers.size());
+  remember();
+  return *this;
+}
+
+MagicalContainer::PrimeIterator &
+MagicalContainer::PrimeIterator::operator-=(difference_type offset) {
+  return *this += -offset;
+}
+
+MagicalContainer::PrimeIterator
+MagicalContainer::PrimeIterator::operator+(difference_type offset) const {
+  PrimeIterator moved(*this);
+  return moved += offset;
+}
+
+MagicalContainer::PrimeIterator
+MagicalContainer::PrimeIterator::operator-(difference_type offset) const {
+  PrimeIterator moved(*this);
+  return moved -= offset;
+}
+
+MagicalContainer::PrimeIterator::difference_type
+MagicalContainer::PrimeIterator::operator-(const PrimeIterator &other) const {
+  return static_cast<difference_type>(index()) -
+         static_cast<difference_type>(other.index());
+}
+
 MagicalContainer::PrimeIterator MagicalContainer::PrimeIterator::begin() const {
-  return PrimeIterator(container, 0);
+  return PrimeIterator(*container, 0);
 }
 
 MagicalContainer::PrimeIterator MagicalContainer::PrimeIterator::end() const {
-  return PrimeIterator(container, container.prime_pointers.size());
+  return PrimeIterator(*container, container->prime_pointers.size());
+}
+
+std::vector<std::pair<MagicalContainer::PrimeIterator,
+                      MagicalContainer::PrimeIterator>>
+MagicalContainer::PrimeIterator::split(const PrimeIterator &last,
+                                       std::size_t parts) const {
+  if (container != last.container) {
+    throw std::runtime_error("Iterators belong to different containers");
+  }
+  std::vector<std::size_t> points =
+      splitPoints(index(), last.index(), parts);
+  std::vector<std::pair<PrimeIterator, PrimeIterator>> ranges;
+  ranges.reserve(parts);
+  for (std::size_t part = 0; part < parts; ++part) {
+    ranges.emplace_back(PrimeIterator(*container, points[part]),
+                        PrimeIterator(*container, points[part + 1]));
+  }
+  return ranges;
 }
 
 } // namespace ariel
@@ -1,6 +1,19 @@
 #ifndef MAGICALCONTAINER_HPP
 #define MAGICALCONTAINER_HPP
 
+#include "CompressedSnapshot.hpp"
+#include "EytzingerIndex.hpp"
+#include "LearnedIndex.hpp"
+#include "MappedMagicalContainer.hpp"
+#include "SnapshotView.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace ariel {
@@ -8,33 +21,146 @@ namespace ariel {
 // Helper function to check if a number is prime
 bool isPrime(int num);
 
+// The three ways a MagicalContainer can be traversed
+enum class TraversalOrder { Ascending, SideCross, Prime };
+
+// File formats of MagicalContainer::exportTo: native int32 values back to
+// back, or decimal text with one value per line
+enum class ExportFormat { Binary, Text };
+
 class MagicalContainer {
 private:
   std::vector<int> sortedElements;
   std ::vector<int *> prime_pointers;
+  mutable EytzingerIndex searchIndex;
+  mutable LearnedIndex learnedIndex;
+  bool learnedEnabled = false;
+  mutable std::size_t lookupsSinceMutation = 0;
+
+  // Bumped by every mutation; iterators compare it to spot a changed container
+  std::uint32_t mutationEpoch = 0;
+
+  // Chunked copy-on-write mirror of sortedElements shared with the views
+  // snapshot() returns; made by the first snapshot(), then kept in step by
+  // single-element mutations and dropped by batches
+  mutable std::shared_ptr<SnapshotView::Table> snapshotTable;
+
+  // Lookups in a row, without mutations, before a stale index is rebuilt
+  static constexpr std::size_t INDEX_REBUILD_AFTER = 16;
+
+  // Position of the first element >= element, via the search index
+  std::size_t findPosition(int element) const;
+  void invalidateIndexes();
+
+  // prime_pointers as indexes into sortedElements, and back
+  std::vector<std::size_t> primeIndexes() const;
+  void relinkPrimes(const std::vector<std::size_t> &indexes);
 
 public:
+  // Constructors and assignment; copies re-point prime_pointers at their own
+  // elements
+  MagicalContainer() = default;
+  MagicalContainer(const MagicalContainer &other);
+  MagicalContainer &operator=(const MagicalContainer &other);
+  MagicalContainer(MagicalContainer &&other) = default;
+  MagicalContainer &operator=(MagicalContainer &&other) noexcept;
+  ~MagicalContainer() = default;
+
   void addElement(int element);
   void removeElement(int element);
   int size() const;
 
+  // Inserts a batch with one merge pass instead of one shift per element;
+  // duplicates are ignored
+  void addElements(std::span<const int> elements);
+
+  // Removes a batch with one pass. Throws, leaving the container unchanged,
+  // if any element is missing.
+  void removeElements(std::span<const int> elements);
+  bool contains(int element) const;
+
+  // Number of elements the PrimeIterator visits
+  std::size_t primeCount() const;
+
+  // The elements in ascending order, valid until the next mutation, and the
+  // primes among them in PrimeIterator order; for read-only copies
+  std::span<const int> elements() const;
+  std::vector<int> primes() const;
+
+  // Use a piecewise-linear model with the given error bound for lookups. The
+  // model is rebuilt once reads settle after mutations; until then lookups
+  // fall back to binary search.
+  void enableLearnedIndex(std::size_t epsilon = 32);
+
+  // Builds any stale lookup index now, so later const calls do not write to
+  // the container. Call before sharing a container between threads.
+  void prepareLookups() const;
+
+  // Immutable delta-compressed copy for read-mostly use
+  CompressedSnapshot freeze() const;
+
+  // Writes the elements and the prime index as a snapshot file (format in
+  // MappedMagicalContainer.hpp); replaces path only once the file is complete
+  void save(const std::string &path) const;
+
+  // Maps a file written by save() read-only. O(1): only the header is read
+  // now, the rest is paged in by iteration.
+  static MappedMagicalContainer mapFromFile(const std::string &path);
+
+  // O(1) point-in-time view, safe to read while this container changes. The
+  // first call (and the first after a batch) builds the mirror in O(n). Like
+  // other calls, not to be run concurrently with mutations.
+  SnapshotView snapshot() const;
+
+  // Builds a container from unsorted values, possibly with duplicates, using
+  // up to threads workers (0 means one per hardware thread) to sort, dedupe
+  // and classify primes
+  static MagicalContainer buildParallel(std::span<const int> values,
+                                        unsigned threads = 0);
+
+  // Builds a container from text holding integers separated by newlines,
+  // commas, spaces or tabs. Reads in large blocks, parses with from_chars and
+  // inserts through buildParallel. Throws on anything else in the input.
+  static MagicalContainer loadText(int fd);
+  static MagicalContainer loadText(const std::string &path);
+
+  // Writes the elements in the given traversal order. Ascending binary output
+  // is written straight from the element array; the other orders are
+  // gathered in batches first.
+  void exportTo(int fd, TraversalOrder order, ExportFormat format) const;
+  void exportTo(const std::string &path, TraversalOrder order,
+                ExportFormat format) const;
+
   class AscendingIterator {
   private:
-    MagicalContainer &container;
-    std::size_t currentIndex;
+    MagicalContainer *container;
+    mutable std::size_t currentIndex;
+
+    // The container's mutation epoch when the cursor was last placed, and the
+    // value it was on (unless it was at the end)
+    mutable std::uint32_t epoch = 0;
+    mutable int anchor = 0;
+    mutable bool anchored = false;
+
+    void remember() const;
+    std::size_t index() const;
 
   public:
+    // Iterator traits, so standard (and parallel) algorithms accept the range
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = int;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const int *;
+    using reference = const int &;
+
+    // Default constructor: a singular iterator that may only be assigned to
+    AscendingIterator();
+
     // Move constructor
     AscendingIterator(AscendingIterator &&other) = default;
 
     // Move assignment operator
-    AscendingIterator &operator=(AscendingIterator &&other) noexcept {
-      if (this != &other) {
-        container = other.container;
-        currentIndex = other.currentIndex;
-      }
-      return *this;
-    }
+    AscendingIterator &operator=(AscendingIterator &&other);
 
     // Copy constructor
     AscendingIterator(const AscendingIterator &other);
@@ -53,31 +179,80 @@ public:
     bool operator!=(const AscendingIterator &other) const;
     bool operator>(const AscendingIterator &other) const;
     bool operator<(const AscendingIterator &other) const;
+    bool operator>=(const AscendingIterator &other) const;
+    bool operator<=(const AscendingIterator &other) const;
 
-    // Dereference operator
-    int operator*() const;
+    // Dereference operators
+    const int & operator*() const;
+    const int & operator[](difference_type offset) const;
 
-    // Increment operator
+    // Increment and decrement operators
     AscendingIterator &operator++();
+    AscendingIterator operator++(int);
+    AscendingIterator &operator--();
+    AscendingIterator operator--(int);
+
+    // Random access arithmetic
+    AscendingIterator &operator+=(difference_type offset);
+    AscendingIterator &operator-=(difference_type offset);
+    AscendingIterator operator+(difference_type offset) const;
+    AscendingIterator operator-(difference_type offset) const;
+    difference_type operator-(const AscendingIterator &other) const;
+    friend AscendingIterator operator+(difference_type offset,
+                                       const AscendingIterator &it) {
+      return it + offset;
+    }
 
     // Iterator begin and end functions
     AscendingIterator begin() const;
     AscendingIterator end() const;
+
+    // Splits [*this, last) into parts consecutive sub-ranges whose sizes
+    // differ by at most one, without walking it
+    std::vector<std::pair<AscendingIterator, AscendingIterator>>
+    split(const AscendingIterator &last, std::size_t parts) const;
   };
 
   class SideCrossIterator {
   private:
-    MagicalContainer &container;
+    MagicalContainer *container;
     std::size_t currentIndex;
     bool reverse;
-    int number_steps = 0;
+
+    // The container's mutation epoch when the iterator was made. A position
+    // names a different element once the size changes, so this order cannot
+    // re-seek like the other two; debug builds throw instead.
+    std::uint32_t generation;
+
+    // Index in the side-cross order: front elements even, back elements odd
+    std::size_t position() const;
+    void seek(std::size_t target);
+
+    // Compiled out under NDEBUG
+    void checkGeneration() const {
+#ifndef NDEBUG
+      if (container != nullptr && generation != container->mutationEpoch) {
+        throw std::runtime_error("Iterator invalidated by a mutation");
+      }
+#endif
+    }
 
   public:
+    // Iterator traits, so standard (and parallel) algorithms accept the range
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = int;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const int *;
+    using reference = const int &;
+
+    // Default constructor: a singular iterator that may only be assigned to
+    SideCrossIterator();
+
     // Move constructor
     SideCrossIterator(SideCrossIterator &&other) = default;
 
     // Move assignment operator
-    SideCrossIterator &operator=(SideCrossIterator &&other) noexcept;
+    SideCrossIterator &operator=(SideCrossIterator &&other);
 
     // Copy constructor
     SideCrossIterator(const SideCrossIterator &other);
@@ -97,29 +272,70 @@ public:
     bool operator!=(const SideCrossIterator &other) const;
     bool operator>(const SideCrossIterator &other) const;
     bool operator<(const SideCrossIterator &other) const;
+    bool operator>=(const SideCrossIterator &other) const;
+    bool operator<=(const SideCrossIterator &other) const;
 
-    // Dereference operator
-    int operator*() const;
+    // Dereference operators
+    const int & operator*() const;
+    const int & operator[](difference_type offset) const;
 
-    // Increment operator
+    // Increment and decrement operators
     SideCrossIterator &operator++();
+    SideCrossIterator operator++(int);
+    SideCrossIterator &operator--();
+    SideCrossIterator operator--(int);
+
+    // Random access arithmetic
+    SideCrossIterator &operator+=(difference_type offset);
+    SideCrossIterator &operator-=(difference_type offset);
+    SideCrossIterator operator+(difference_type offset) const;
+    SideCrossIterator operator-(difference_type offset) const;
+    difference_type operator-(const SideCrossIterator &other) const;
+    friend SideCrossIterator operator+(difference_type offset,
+                                       const SideCrossIterator &it) {
+      return it + offset;
+    }
 
     // Iterator begin and end functions
     SideCrossIterator begin() const;
     SideCrossIterator end() const;
+
+    // Splits [*this, last) into parts consecutive sub-ranges whose sizes
+    // differ by at most one, without walking it
+    std::vector<std::pair<SideCrossIterator, SideCrossIterator>>
+    split(const SideCrossIterator &last, std::size_t parts) const;
   };
 
   class PrimeIterator {
   private:
-    MagicalContainer &container;
-    std::size_t currentIndex;
+    MagicalContainer *container;
+    mutable std::size_t currentIndex;
+
+    // The container's mutation epoch when the cursor was last placed, and the
+    // value it was on (unless it was at the end)
+    mutable std::uint32_t epoch = 0;
+    mutable int anchor = 0;
+    mutable bool anchored = false;
+
+    void remember() const;
+    std::size_t index() const;
 
   public:
+    // Iterator traits, so standard (and parallel) algorithms accept the range
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = int;
+    using difference_type = std::ptrdiff_t;
+    using pointer = int *;
+    using reference = int &;
+
+    // Default constructor: a singular iterator that may only be assigned to
+    PrimeIterator();
+
     // Move constructor
     PrimeIterator(PrimeIterator &&other) = default;
 
     // Move assignment operator
-    PrimeIterator &operator=(PrimeIterator &&other) noexcept;
+    PrimeIterator &operator=(PrimeIterator &&other);
 
     // Copy constructor
     PrimeIterator(const PrimeIterator &other);
@@ -138,16 +354,38 @@ public:
     bool operator!=(const PrimeIterator &other) const;
     bool operator>(const PrimeIterator &other) const;
     bool operator<(const PrimeIterator &other) const;
+    bool operator>=(const PrimeIterator &other) const;
+    bool operator<=(const PrimeIterator &other) const;
 
-    // Dereference operator
-    int &operator*() const;
+    // Dereference operators
+    int & operator*() const;
+    int & operator[](difference_type offset) const;
 
-    // Increment operator
+    // Increment and decrement operators
     PrimeIterator &operator++();
+    PrimeIterator operator++(int);
+    PrimeIterator &operator--();
+    PrimeIterator operator--(int);
+
+    // Random access arithmetic
+    PrimeIterator &operator+=(difference_type offset);
+    PrimeIterator &operator-=(difference_type offset);
+    PrimeIterator operator+(difference_type offset) const;
+    PrimeIterator operator-(difference_type offset) const;
+    difference_type operator-(const PrimeIterator &other) const;
+    friend PrimeIterator operator+(difference_type offset,
+                                   const PrimeIterator &it) {
+      return it + offset;
+    }
 
     // Iterator begin and end functions
     PrimeIterator begin() const;
     PrimeIterator end() const;
+
+    // Splits [*this, last) into parts consecutive sub-ranges whose sizes
+    // differ by at most one, without walking it
+    std::vector<std::pair<PrimeIterator, PrimeIterator>>
+    split(const PrimeIterator &last, std::size_t parts) const;
   };
 };
 
@@ -0,0 +1,208 @@
+// MagicalContainer's file input and output, kept apart from the container
+// logic in MagicalContainer.cpp
+#include "FileIO.hpp"
+#include "MagicalContainer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <fcntl.h>
+#include <optional>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ariel {
+
+namespace {
+
+constexpr std::size_t READ_BLOCK = std::size_t{1} << 20;
+constexpr std::size_t EXPORT_BATCH = std::size_t{1} << 16; // values
+constexpr std::size_t TEXT_BLOCK = std::size_t{1} << 20;   // bytes
+
+void writeExport(int fd, const void *data, std::size_t size) {
+  if (!writeAll(fd, data, size)) {
+    throw std::runtime_error("Cannot write export");
+  }
+}
+
+// Formats values as decimal lines into a block and writes it when full
+class TextWriter {
+private:
+  int fd;
+  std::vector<char> block;
+  std::size_t used = 0;
+
+  // Longest line: "-2147483648\n"
+  static constexpr std::size_t MAX_LINE = 12;
+
+public:
+  explicit TextWriter(int fd) : fd(fd), block(TEXT_BLOCK) {}
+
+  void write(std::span<const int> values) {
+    for (int value : values) {
+      if (block.size() - used < MAX_LINE) {
+        flush();
+      }
+      char *end = std::to_chars(block.data() + used,
+                                block.data() + block.size(), value)
+                      .ptr;
+      *end = '\n';
+      used = static_cast<std::size_t>(end + 1 - block.data());
+    }
+  }
+
+  void flush() {
+    writeExport(fd, block.data(), used);
+    used = 0;
+  }
+};
+
+bool isSeparator(char c) {
+  return c == '\n' || c == ',' || c == ' ' || c == '\r' || c == '\t';
+}
+
+// Appends the integers in [begin, end), which must not end inside a number
+void parseIntegers(const char *begin, const char *end,
+                   std::vector<int> &values) {
+  while (begin != end) {
+    if (isSeparator(*begin)) {
+      ++begin;
+      continue;
+    }
+    int value = 0;
+    const char *start = begin;
+    if (*start == '+') { // from_chars takes no '+', and "+-5" is not a number
+      ++start;
+      if (start == end || *start < '0' || *start > '9') {
+        throw std::runtime_error("Invalid integer in input");
+      }
+    }
+    auto [next, error] = std::from_chars(start, end, value);
+    if (error != std::errc() || (next != end && !isSeparator(*next))) {
+      throw std::runtime_error("Invalid integer in input");
+    }
+    values.push_back(value);
+    begin = next;
+  }
+}
+
+} // namespace
+
+// Each block is parsed up to its last separator; the partial number after it
+// is moved to the front of the buffer and completed by the next read
+MagicalContainer MagicalContainer::loadText(int fd) {
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL); // a hint; may fail on pipes
+  std::vector<int> values;
+  struct stat status {};
+  if (::fstat(fd, &status) == 0 && S_ISREG(status.st_mode)) {
+    // Room for a number per 4 bytes of input saves most regrowth
+    values.reserve(static_cast<std::size_t>(status.st_size) / 4);
+  }
+  std::vector<char> buffer(READ_BLOCK);
+  std::size_t carried = 0;
+  for (;;) {
+    if (carried == buffer.size()) {
+      throw std::runtime_error("Invalid integer in input");
+    }
+    ssize_t got = ::read(fd, buffer.data() + carried, buffer.size() - carried);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got < 0) {
+      throw std::runtime_error("Cannot read input");
+    }
+    const char *begin = buffer.data();
+    const char *end = begin + carried + static_cast<std::size_t>(got);
+    if (got == 0) {
+      parseIntegers(begin, end, values);
+      break;
+    }
+    const char *cut = end;
+    while (cut != begin && !isSeparator(cut[-1])) {
+      --cut;
+    }
+    parseIntegers(begin, cut, values);
+    carried = static_cast<std::size_t>(end - cut);
+    std::copy(cut, end, buffer.data());
+  }
+  return buildParallel(values);
+}
+
+MagicalContainer MagicalContainer::loadText(const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  try {
+    MagicalContainer loaded = loadText(fd);
+    ::close(fd);
+    return loaded;
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+}
+
+void MagicalContainer::exportTo(int fd, TraversalOrder order,
+                                ExportFormat format) const {
+  std::optional<TextWriter> text; // its block only for text output
+  if (format == ExportFormat::Text) {
+    text.emplace(fd);
+  }
+  auto emit = [&](std::span<const int> values) {
+    if (text) {
+      text->write(values);
+    } else {
+      writeExport(fd, values.data(), values.size_bytes());
+    }
+  };
+
+  if (order == TraversalOrder::Ascending) {
+    emit(sortedElements);
+  } else {
+    std::vector<int> batch;
+    batch.reserve(EXPORT_BATCH);
+    auto gather = [&](int value) {
+      batch.push_back(value);
+      if (batch.size() == EXPORT_BATCH) {
+        emit(batch);
+        batch.clear();
+      }
+    };
+    if (order == TraversalOrder::Prime) {
+      for (const int *prime : prime_pointers) {
+        gather(*prime);
+      }
+    } else {
+      const std::size_t count = sortedElements.size();
+      for (std::size_t front = 0, back = count; front < back;) {
+        gather(sortedElements[front++]);
+        if (front < back) {
+          gather(sortedElements[--back]);
+        }
+      }
+    }
+    emit(batch);
+  }
+  if (text) {
+    text->flush();
+  }
+}
+
+void MagicalContainer::exportTo(const std::string &path, TraversalOrder order,
+                                ExportFormat format) const {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open " + path);
+  }
+  try {
+    exportTo(fd, order, format);
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+  if (::close(fd) != 0) {
+    throw std::runtime_error("Cannot write export");
+  }
+}
+
+} // namespace ariel
@@ -0,0 +1,464 @@
+#include "MappedMagicalContainer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace ariel {
+
+namespace {
+
+constexpr char MAGIC[8] = {'M', 'A', 'G', 'I', 'C', 'S', 'N', 'P'};
+constexpr std::size_t WRITE_BLOCK = 4096;
+
+// Iterators ask the kernel to read this many elements ahead, per direction
+constexpr std::size_t READAHEAD = std::size_t{1} << 14;
+
+// Starts reading values [first, first + count) into the page cache; the range
+// is clipped to values
+template <typename T>
+void willNeed(std::span<const T> values, std::ptrdiff_t first,
+              std::size_t count) {
+  const auto size = static_cast<std::ptrdiff_t>(values.size());
+  std::ptrdiff_t last = std::min(size, first + static_cast<std::ptrdiff_t>(count));
+  first = std::max<std::ptrdiff_t>(first, 0);
+  if (first >= last)
+    return;
+  static const auto page = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+  auto begin = reinterpret_cast<std::uintptr_t>(values.data() + first);
+  auto end = reinterpret_cast<std::uintptr_t>(values.data() + last);
+  begin &= ~(page - 1);
+  ::madvise(reinterpret_cast<void *>(begin), end - begin, MADV_WILLNEED);
+}
+
+std::span<const std::uint32_t> wordsOf(std::span<const int> values) {
+  return {reinterpret_cast<const std::uint32_t *>(values.data()),
+          values.size()};
+}
+
+} // namespace
+
+void MappedMagicalContainer::Checksum::update(
+    std::span<const std::uint32_t> words) {
+  std::uint64_t hash = state;
+  for (std::uint32_t word : words) {
+    hash = (hash ^ word) * 0x100000001b3ULL;
+  }
+  state = hash;
+}
+
+std::uint64_t MappedMagicalContainer::Checksum::value() const { return state; }
+
+// Writer
+MappedMagicalContainer::Writer::Writer(const std::string &path)
+    : path(path), out(path + ".tmp", std::ios::binary | std::ios::trunc) {
+  if (!out) {
+    throw std::runtime_error("Cannot write snapshot: " + path);
+  }
+  Header placeholder{}; // no magic, so a torn file is never accepted
+  out.write(reinterpret_cast<const char *>(&placeholder), sizeof(Header));
+  pending.reserve(WRITE_BLOCK);
+}
+
+MappedMagicalContainer::Writer::~Writer() {
+  if (primeSpill.is_open()) {
+    primeSpill.close();
+    std::remove((path + ".primes.tmp").c_str());
+  }
+  if (!finished) {
+    out.close();
+    std::remove((path + ".tmp").c_str());
+  }
+}
+
+void MappedMagicalContainer::Writer::add(int element, bool prime) {
+  if (count > 0 && element <= last) {
+    throw std::runtime_error("Snapshot elements must be ascending");
+  }
+  if (prime) {
+    primeIndexes.push_back(static_cast<std::uint32_t>(count));
+    ++primeCount;
+    if (primeIndexes.size() == WRITE_BLOCK) {
+      spillPrimes();
+    }
+  }
+  pending.push_back(element);
+  last = element;
+  ++count;
+  if (pending.size() == WRITE_BLOCK) {
+    writePending();
+  }
+}
+
+void MappedMagicalContainer::Writer::writePending() {
+  checksum.update(wordsOf(pending));
+  out.write(reinterpret_cast<const char *>(pending.data()),
+            static_cast<std::streamsize>(pending.size() * sizeof(int)));
+  pending.clear();
+}
+
+void MappedMagicalContainer::Writer::spillPrimes() {
+  if (!primeSpill.is_open()) {
+    primeSpill.open(path + ".primes.tmp", std::ios::in | std::ios::out |
+                                              std::ios::binary |
+                                              std::ios::trunc);
+  }
+  primeSpill.write(reinterpret_cast<const char *>(primeIndexes.data()),
+                   static_cast<std::streamsize>(primeIndexes.size() *
+                                                sizeof(std::uint32_t)));
+  primeIndexes.clear();
+}
+
+void MappedMagicalContainer::Writer::finish() {
+  writePending();
+  if (primeSpill.is_open()) {
+    spillPrimes();
+    primeSpill.seekg(0);
+    primeIndexes.resize(WRITE_BLOCK);
+    for (std::uint64_t left = primeCount; left > 0;) {
+      std::size_t block =
+          static_cast<std::size_t>(std::min<std::uint64_t>(left, WRITE_BLOCK));
+      primeSpill.read(reinterpret_cast<char *>(primeIndexes.data()),
+                      static_cast<std::streamsize>(block * sizeof(std::uint32_t)));
+      if (!primeSpill) {
+        throw std::runtime_error("Cannot write snapshot: " + path);
+      }
+      primeIndexes.resize(block);
+      checksum.update(primeIndexes);
+      out.write(reinterpret_cast<const char *>(primeIndexes.data()),
+                static_cast<std::streamsize>(block * sizeof(std::uint32_t)));
+      left -= block;
+    }
+  } else {
+    checksum.update(primeIndexes);
+    out.write(reinterpret_cast<const char *>(primeIndexes.data()),
+              static_cast<std::streamsize>(primeIndexes.size() *
+                                           sizeof(std::uint32_t)));
+  }
+
+  Header header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.formatVersion = FORMAT_VERSION;
+  header.headerSize = sizeof(Header);
+  header.count = count;
+  header.primeCount = primeCount;
+  header.checksum = checksum.value();
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+  out.flush();
+  out.close();
+
+  // On disk before the rename, so the name never points at a partial file
+  int fd = ::open((path + ".tmp").c_str(), O_RDONLY);
+  bool flushed = fd >= 0 && ::fsync(fd) == 0;
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  if (!out || !flushed ||
+      std::rename((path + ".tmp").c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("Cannot write snapshot: " + path);
+  }
+  finished = true;
+}
+
+void MappedMagicalContainer::checkHeader(const Header &header,
+                                         std::uint64_t fileSize,
+                                         const std::string &path) {
+  const char *problem = nullptr;
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.headerSize < sizeof(Header) || header.headerSize % 4 != 0) {
+    problem = "Invalid snapshot: ";
+  } else if (header.formatVersion != FORMAT_VERSION) {
+    problem = "Unsupported snapshot version: ";
+  } else {
+    const std::uint64_t words = (fileSize - header.headerSize) / 4;
+    if (header.headerSize > fileSize ||
+        (fileSize - header.headerSize) % 4 != 0 || header.count > words ||
+        header.primeCount != words - header.count) {
+      problem = "Truncated snapshot: ";
+    }
+  }
+  if (problem != nullptr) {
+    throw std::runtime_error(problem + path);
+  }
+}
+
+// Mapping
+MappedMagicalContainer::MappedMagicalContainer(const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open snapshot: " + path);
+  }
+  struct stat status {};
+  if (::fstat(fd, &status) != 0 ||
+      static_cast<std::size_t>(status.st_size) < sizeof(Header)) {
+    ::close(fd);
+    throw std::runtime_error("Invalid snapshot: " + path);
+  }
+  mappingSize = static_cast<std::size_t>(status.st_size);
+  mapping = ::mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd); // the mapping stays valid
+  if (mapping == MAP_FAILED) {
+    mapping = nullptr;
+    throw std::runtime_error("Cannot map snapshot: " + path);
+  }
+
+  header = static_cast<const Header *>(mapping);
+  try {
+    checkHeader(*header, mappingSize, path);
+  } catch (...) {
+    ::munmap(mapping, mappingSize);
+    mapping = nullptr;
+    throw;
+  }
+
+  const char *base = static_cast<const char *>(mapping) + header->headerSize;
+  elements = {reinterpret_cast<const int *>(base), header->count};
+  primeIndexes = {reinterpret_cast<const std::uint32_t *>(elements.data() +
+                                                          elements.size()),
+                  header->primeCount};
+}
+
+MappedMagicalContainer::MappedMagicalContainer(
+    MappedMagicalContainer &&other) noexcept
+    : mapping(std::exchange(other.mapping, nullptr)),
+      mappingSize(std::exchange(other.mappingSize, 0)),
+      header(std::exchange(other.header, nullptr)),
+      elements(std::exchange(other.elements, {})),
+      primeIndexes(std::exchange(other.primeIndexes, {})) {}
+
+MappedMagicalContainer &
+MappedMagicalContainer::operator=(MappedMagicalContainer &&other) noexcept {
+  if (this != &other) {
+    if (mapping != nullptr) {
+      ::munmap(mapping, mappingSize);
+    }
+    mapping = std::exchange(other.mapping, nullptr);
+    mappingSize = std::exchange(other.mappingSize, 0);
+    header = std::exchange(other.header, nullptr);
+    elements = std::exchange(other.elements, {});
+    primeIndexes = std::exchange(other.primeIndexes, {});
+  }
+  return *this;
+}
+
+MappedMagicalContainer::~MappedMagicalContainer() {
+  if (mapping != nullptr) {
+    ::munmap(mapping, mappingSize);
+  }
+}
+
+int MappedMagicalContainer::size() const {
+  return static_cast<int>(elements.size());
+}
+
+std::size_t MappedMagicalContainer::primeCount() const {
+  return primeIndexes.size();
+}
+
+bool MappedMagicalContainer::contains(int element) const {
+  return std::binary_search(elements.begin(), elements.end(), element);
+}
+
+bool MappedMagicalContainer::verify() const {
+  Checksum checksum;
+  checksum.update(wordsOf(elements));
+  checksum.update(primeIndexes);
+  return header != nullptr && checksum.value() == header->checksum;
+}
+
+// AscendingIterator
+MappedMagicalContainer::AscendingIterator::AscendingIterator(
+    const MappedMagicalContainer &cont, std::size_t index)
+    : container(&cont), currentIndex(index) {
+  willNeed(cont.elements, static_cast<std::ptrdiff_t>(index), 2 * READAHEAD);
+}
+
+bool MappedMagicalContainer::AscendingIterator::operator==(
+    const AscendingIterator &other) const {
+  return currentIndex == other.currentIndex;
+}
+
+bool MappedMagicalContainer::AscendingIterator::operator!=(
+    const AscendingIterator &other) const {
+  return !(*this == other);
+}
+
+bool MappedMagicalContainer::AscendingIterator::operator>(
+    const AscendingIterator &other) const {
+  return currentIndex > other.currentIndex;
+}
+
+bool MappedMagicalContainer::AscendingIterator::operator<(
+    const AscendingIterator &other) const {
+  return currentIndex < other.currentIndex;
+}
+
+int MappedMagicalContainer::AscendingIterator::operator*() const {
+  if (currentIndex >= container->elements.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  return container->elements[currentIndex];
+}
+
+MappedMagicalContainer::AscendingIterator &
+MappedMagicalContainer::AscendingIterator::operator++() {
+  if (currentIndex >= container->elements.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++currentIndex;
+  if (currentIndex % READAHEAD == 0) { // entered a window: fetch the next
+    willNeed(container->elements,
+             static_cast<std::ptrdiff_t>(currentIndex + READAHEAD), READAHEAD);
+  }
+  return *this;
+}
+
+MappedMagicalContainer::AscendingIterator
+MappedMagicalContainer::AscendingIterator::begin() const {
+  return AscendingIterator(*container, 0);
+}
+
+MappedMagicalContainer::AscendingIterator
+MappedMagicalContainer::AscendingIterator::end() const {
+  return AscendingIterator(*container, container->elements.size());
+}
+
+// SideCrossIterator
+// Reads ahead at both ends: upwards from the front and downwards from the back
+MappedMagicalContainer::SideCrossIterator::SideCrossIterator(
+    const MappedMagicalContainer &cont, std::size_t index)
+    : container(&cont), currentIndex(index) {
+  const auto taken = static_cast<std::ptrdiff_t>(index / 2);
+  const auto size = static_cast<std::ptrdiff_t>(cont.elements.size());
+  const auto window = static_cast<std::ptrdiff_t>(2 * READAHEAD);
+  if (index < cont.elements.size()) { // not for end()
+    willNeed(cont.elements, taken, 2 * READAHEAD);
+    willNeed(cont.elements, size - taken - window, 2 * READAHEAD);
+  }
+}
+
+bool MappedMagicalContainer::SideCrossIterator::operator==(
+    const SideCrossIterator &other) const {
+  return currentIndex == other.currentIndex;
+}
+
+bool MappedMagicalContainer::SideCrossIterator::operator!=(
+    const SideCrossIterator &other) const {
+  return !(*this == other);
+}
+
+bool MappedMagicalContainer::SideCrossIterator::operator>(
+    const SideCrossIterator &other) const {
+  return currentIndex > other.currentIndex;
+}
+
+bool MappedMagicalContainer::SideCrossIterator::operator<(
+    const SideCrossIterator &other) const {
+  return currentIndex < other.currentIndex;
+}
+
+int MappedMagicalContainer::SideCrossIterator::operator*() const {
+  std::span<const int> elements = container->elements;
+  if (currentIndex >= elements.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  if (currentIndex % 2 == 0)
+    return elements[currentIndex / 2];
+  return elements[elements.size() - 1 - currentIndex / 2];
+}
+
+MappedMagicalContainer::SideCrossIterator &
+MappedMagicalContainer::SideCrossIterator::operator++() {
+  if (currentIndex >= container->elements.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++currentIndex;
+  if (currentIndex % (2 * READAHEAD) == 0) {
+    const auto taken = static_cast<std::ptrdiff_t>(currentIndex / 2);
+    const auto size = static_cast<std::ptrdiff_t>(container->elements.size());
+    const auto window = static_cast<std::ptrdiff_t>(READAHEAD);
+    willNeed(container->elements, taken + window, READAHEAD);
+    willNeed(container->elements, size - taken - 2 * window, READAHEAD);
+  }
+  return *this;
+}
+
+MappedMagicalContainer::SideCrossIterator
+MappedMagicalContainer::SideCrossIterator::begin() const {
+  return SideCrossIterator(*container, 0);
+}
+
+MappedMagicalContainer::SideCrossIterator
+MappedMagicalContainer::SideCrossIterator::end() const {
+  return SideCrossIterator(*container, container->elements.size());
+}
+
+// PrimeIterator
+// Reads ahead in the prime index; the elements it points to are sparse and
+// left to the kernel
+MappedMagicalContainer::PrimeIterator::PrimeIterator(
+    const MappedMagicalContainer &cont, std::size_t index)
+    : container(&cont), currentIndex(index) {
+  willNeed(cont.primeIndexes, static_cast<std::ptrdiff_t>(index),
+           2 * READAHEAD);
+}
+
+bool MappedMagicalContainer::PrimeIterator::operator==(
+    const PrimeIterator &other) const {
+  return currentIndex == other.currentIndex;
+}
+
+bool MappedMagicalContainer::PrimeIterator::operator!=(
+    const PrimeIterator &other) const {
+  return !(*this == other);
+}
+
+bool MappedMagicalContainer::PrimeIterator::operator>(
+    const PrimeIterator &other) const {
+  return currentIndex > other.currentIndex;
+}
+
+bool MappedMagicalContainer::PrimeIterator::operator<(
+    const PrimeIterator &other) const {
+  return currentIndex < other.currentIndex;
+}
+
+// A corrupt prime index must not read outside the mapping
+int MappedMagicalContainer::PrimeIterator::operator*() const {
+  if (currentIndex >= container->primeIndexes.size() ||
+      container->primeIndexes[currentIndex] >= container->elements.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  return container->elements[container->primeIndexes[currentIndex]];
+}
+
+MappedMagicalContainer::PrimeIterator &
+MappedMagicalContainer::PrimeIterator::operator++() {
+  if (currentIndex >= container->primeIndexes.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++currentIndex;
+  if (currentIndex % READAHEAD == 0) {
+    willNeed(container->primeIndexes,
+             static_cast<std::ptrdiff_t>(currentIndex + READAHEAD), READAHEAD);
+  }
+  return *this;
+}
+
+MappedMagicalContainer::PrimeIterator
+MappedMagicalContainer::PrimeIterator::begin() const {
+  return PrimeIterator(*container, 0);
+}
+
+MappedMagicalContainer::PrimeIterator
+MappedMagicalContainer::PrimeIterator::end() const {
+  return PrimeIterator(*container, container->primeIndexes.size());
+}
+
+} // namespace ariel
@@ -0,0 +1,188 @@
+#ifndef MAPPEDMAGICALCONTAINER_HPP
+#define MAPPEDMAGICALCONTAINER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ariel {
+
+// Read-only container over a snapshot file mapped into memory, from
+// MagicalContainer::mapFromFile(). Opening only checks the header, so it is
+// O(1); pages are read from disk as iteration first touches them.
+//
+// File layout, native byte order (written and read on the same platform):
+//   Header                         40 bytes, see below
+//   int32_t  elements[count]       sorted, no duplicates
+//   uint32_t primeIndexes[primes]  positions of the primes in elements
+class MappedMagicalContainer {
+public:
+  static constexpr std::uint32_t FORMAT_VERSION = 1;
+
+  struct Header {
+    char magic[8];              // "MAGICSNP"
+    std::uint32_t formatVersion;
+    std::uint32_t headerSize;   // offset of elements
+    std::uint64_t count;
+    std::uint64_t primeCount;
+    std::uint64_t checksum;     // Checksum of elements, then primeIndexes
+  };
+
+  // 64-bit FNV-1a over the 32-bit words of elements, then of primeIndexes
+  class Checksum {
+  private:
+    std::uint64_t state = 0xcbf29ce484222325ULL;
+
+  public:
+    void update(std::span<const std::uint32_t> words);
+    std::uint64_t value() const;
+  };
+
+  // Throws unless header describes a snapshot of this version whose size
+  // matches fileSize
+  static void checkHeader(const Header &header, std::uint64_t fileSize,
+                          const std::string &path);
+
+  // Streams a snapshot to disk in ascending order, in bounded memory. The
+  // file appears under path only once finish() succeeds; until then it is
+  // written to path.tmp.
+  class Writer {
+  private:
+    std::string path;
+    std::ofstream out;
+    std::uint64_t count = 0;  // elements added
+    int last = 0;
+    std::vector<int> pending; // elements added but not yet written
+    Checksum checksum;
+    bool finished = false;
+
+    // Prime positions go after all elements; past one block they wait in
+    // path.primes.tmp, so memory stays bounded for any file size
+    std::vector<std::uint32_t> primeIndexes;
+    std::uint64_t primeCount = 0;
+    std::fstream primeSpill;
+
+    void writePending();
+    void spillPrimes();
+
+  public:
+    explicit Writer(const std::string &path);
+    Writer(const Writer &) = delete;
+    Writer &operator=(const Writer &) = delete;
+    ~Writer(); // removes the temporary files unless finished
+
+    // Elements must arrive strictly ascending
+    void add(int element, bool prime);
+    void finish();
+  };
+
+private:
+  void *mapping = nullptr;
+  std::size_t mappingSize = 0;
+  const Header *header = nullptr;
+  std::span<const int> elements;
+  std::span<const std::uint32_t> primeIndexes;
+
+public:
+  // Throws if the file is missing, not a snapshot or of another version
+  explicit MappedMagicalContainer(const std::string &path);
+  MappedMagicalContainer(MappedMagicalContainer &&other) noexcept;
+  MappedMagicalContainer &operator=(MappedMagicalContainer &&other) noexcept;
+  MappedMagicalContainer(const MappedMagicalContainer &) = delete;
+  MappedMagicalContainer &operator=(const MappedMagicalContainer &) = delete;
+  ~MappedMagicalContainer();
+
+  int size() const;
+  std::size_t primeCount() const;
+  bool contains(int element) const;
+
+  // Reads the whole file and compares it with the stored checksum
+  bool verify() const;
+
+  class AscendingIterator {
+  private:
+    const MappedMagicalContainer *container;
+    std::size_t currentIndex;
+
+  public:
+    // Constructor
+    AscendingIterator(const MappedMagicalContainer &cont,
+                      std::size_t index = 0);
+
+    // Comparison operators
+    bool operator==(const AscendingIterator &other) const;
+    bool operator!=(const AscendingIterator &other) const;
+    bool operator>(const AscendingIterator &other) const;
+    bool operator<(const AscendingIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    AscendingIterator &operator++();
+
+    // Iterator begin and end functions
+    AscendingIterator begin() const;
+    AscendingIterator end() const;
+  };
+
+  class SideCrossIterator {
+  private:
+    const MappedMagicalContainer *container;
+    std::size_t currentIndex; // steps taken, alternating front and back
+
+  public:
+    // Constructor
+    SideCrossIterator(const MappedMagicalContainer &cont,
+                      std::size_t index = 0);
+
+    // Comparison operators
+    bool operator==(const SideCrossIterator &other) const;
+    bool operator!=(const SideCrossIterator &other) const;
+    bool operator>(const SideCrossIterator &other) const;
+    bool operator<(const SideCrossIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    SideCrossIterator &operator++();
+
+    // Iterator begin and end functions
+    SideCrossIterator begin() const;
+    SideCrossIterator end() const;
+  };
+
+  class PrimeIterator {
+  private:
+    const MappedMagicalContainer *container;
+    std::size_t currentIndex;
+
+  public:
+    // Constructor
+    PrimeIterator(const MappedMagicalContainer &cont, std::size_t index = 0);
+
+    // Comparison operators
+    bool operator==(const PrimeIterator &other) const;
+    bool operator!=(const PrimeIterator &other) const;
+    bool operator>(const PrimeIterator &other) const;
+    bool operator<(const PrimeIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    PrimeIterator &operator++();
+
+    // Iterator begin and end functions
+    PrimeIterator begin() const;
+    PrimeIterator end() const;
+  };
+};
+
+} // namespace ariel
+
+#endif /* MAPPEDMAGICALCONTAINER_HPP */
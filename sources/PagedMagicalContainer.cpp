@@ -0,0 +1,406 @@
+#include "PagedMagicalContainer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace ariel {
+
+namespace {
+
+// Iterators ask the kernel to read this many words ahead, per direction
+constexpr std::size_t READAHEAD = std::size_t{1} << 14;
+
+} // namespace
+
+double PagedMagicalContainer::Metrics::hitRate() const {
+  const std::uint64_t accesses = hits + misses;
+  return accesses == 0 ? 0.0
+                       : static_cast<double>(hits) /
+                             static_cast<double>(accesses);
+}
+
+PagedMagicalContainer::PagedMagicalContainer(const std::string &path,
+                                             std::size_t poolPages) {
+  file = ::open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    throw std::runtime_error("Cannot open snapshot: " + path);
+  }
+  struct stat status {};
+  if (::fstat(file, &status) != 0 ||
+      static_cast<std::size_t>(status.st_size) < sizeof(header) ||
+      ::pread(file, &header, sizeof(header), 0) !=
+          static_cast<ssize_t>(sizeof(header))) {
+    ::close(file);
+    throw std::runtime_error("Invalid snapshot: " + path);
+  }
+  try {
+    MappedMagicalContainer::checkHeader(
+        header, static_cast<std::uint64_t>(status.st_size), path);
+  } catch (...) {
+    ::close(file);
+    throw;
+  }
+
+  poolPages = std::max<std::size_t>(poolPages, 1);
+  pool.memory.resize(poolPages * PAGE_SIZE);
+  pool.frames.resize(poolPages);
+  pool.resident.reserve(poolPages);
+}
+
+PagedMagicalContainer::PagedMagicalContainer(
+    PagedMagicalContainer &&other) noexcept
+    : file(std::exchange(other.file, -1)), header(other.header),
+      pool(std::move(other.pool)) {}
+
+PagedMagicalContainer &
+PagedMagicalContainer::operator=(PagedMagicalContainer &&other) noexcept {
+  if (this != &other) {
+    if (file >= 0) {
+      ::close(file);
+    }
+    file = std::exchange(other.file, -1);
+    header = other.header;
+    pool = std::move(other.pool);
+  }
+  return *this;
+}
+
+PagedMagicalContainer::~PagedMagicalContainer() {
+  if (file >= 0) {
+    ::close(file);
+  }
+}
+
+// CLOCK: the hand sweeps the frames, sparing (and clearing) each referenced
+// one once, and takes the first frame not referenced since its last pass
+const char *PagedMagicalContainer::fetch(std::uint64_t page) const {
+  if (pool.lastValid && pool.frames[pool.lastFrame].page == page) {
+    ++pool.metrics.hits;
+    pool.frames[pool.lastFrame].referenced = true;
+    return pool.memory.data() + pool.lastFrame * PAGE_SIZE;
+  }
+  auto found = pool.resident.find(page);
+  if (found != pool.resident.end()) {
+    ++pool.metrics.hits;
+    pool.frames[found->second].referenced = true;
+    pool.lastFrame = found->second;
+    pool.lastValid = true;
+    return pool.memory.data() + found->second * PAGE_SIZE;
+  }
+
+  ++pool.metrics.misses;
+  while (pool.frames[pool.hand].used && pool.frames[pool.hand].referenced) {
+    pool.frames[pool.hand].referenced = false;
+    pool.hand = (pool.hand + 1) % pool.frames.size();
+  }
+  const std::size_t victim = pool.hand;
+  pool.hand = (pool.hand + 1) % pool.frames.size();
+  Frame &frame = pool.frames[victim];
+  if (frame.used) {
+    pool.resident.erase(frame.page);
+    ++pool.metrics.evictions;
+  }
+  frame.used = false; // until the read succeeds
+
+  char *data = pool.memory.data() + victim * PAGE_SIZE;
+  const auto offset = static_cast<off_t>(page * PAGE_SIZE);
+  std::size_t read = 0;
+  while (read < PAGE_SIZE) { // the last page of the file may be short
+    ssize_t got = ::pread(file, data + read, PAGE_SIZE - read,
+                          offset + static_cast<off_t>(read));
+    if (got < 0) {
+      pool.lastValid = false;
+      throw std::runtime_error("Cannot read snapshot page");
+    }
+    if (got == 0)
+      break;
+    read += static_cast<std::size_t>(got);
+  }
+
+  frame.page = page;
+  frame.used = true;
+  frame.referenced = true;
+  pool.resident.emplace(page, victim);
+  pool.lastFrame = victim;
+  pool.lastValid = true;
+  return data;
+}
+
+// Words are 4-byte aligned in the file, so none spans two pages
+std::uint32_t PagedMagicalContainer::word(std::uint64_t offset) const {
+  const char *page = fetch(offset / PAGE_SIZE);
+  std::uint32_t value = 0;
+  std::memcpy(&value, page + offset % PAGE_SIZE, sizeof(value));
+  return value;
+}
+
+std::uint64_t PagedMagicalContainer::elementsOffset() const {
+  return header.headerSize;
+}
+
+std::uint64_t PagedMagicalContainer::primesOffset() const {
+  return header.headerSize + header.count * sizeof(int);
+}
+
+int PagedMagicalContainer::elementAt(std::size_t index) const {
+  return static_cast<int>(word(elementsOffset() + index * sizeof(int)));
+}
+
+std::size_t PagedMagicalContainer::primePosition(std::size_t index) const {
+  return word(primesOffset() + index * sizeof(std::uint32_t));
+}
+
+void PagedMagicalContainer::hintReadahead(std::uint64_t base,
+                                          std::uint64_t size,
+                                          std::ptrdiff_t first,
+                                          std::size_t count) const {
+  const auto words = static_cast<std::ptrdiff_t>(size);
+  std::ptrdiff_t last =
+      std::min(words, first + static_cast<std::ptrdiff_t>(count));
+  first = std::max<std::ptrdiff_t>(first, 0);
+  if (first >= last)
+    return;
+  const std::uint64_t begin = base + static_cast<std::uint64_t>(first) * 4;
+  const std::uint64_t end = base + static_cast<std::uint64_t>(last) * 4;
+  ::posix_fadvise(file, static_cast<off_t>(begin),
+                  static_cast<off_t>(end - begin), POSIX_FADV_WILLNEED);
+  pool.metrics.readaheadHinted += (end - 1) / PAGE_SIZE - begin / PAGE_SIZE + 1;
+}
+
+int PagedMagicalContainer::size() const {
+  return static_cast<int>(header.count);
+}
+
+std::size_t PagedMagicalContainer::primeCount() const {
+  return header.primeCount;
+}
+
+bool PagedMagicalContainer::contains(int element) const {
+  std::size_t low = 0;
+  std::size_t high = header.count;
+  while (low < high) {
+    std::size_t middle = low + (high - low) / 2;
+    if (elementAt(middle) < element)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low < header.count && elementAt(low) == element;
+}
+
+std::size_t PagedMagicalContainer::poolPages() const {
+  return pool.frames.size();
+}
+
+PagedMagicalContainer::Metrics PagedMagicalContainer::metrics() const {
+  return pool.metrics;
+}
+
+void PagedMagicalContainer::resetMetrics() { pool.metrics = Metrics{}; }
+
+// AscendingIterator
+PagedMagicalContainer::AscendingIterator::AscendingIterator(
+    const PagedMagicalContainer &cont, std::size_t index)
+    : container(&cont), currentIndex(index) {
+  cont.hintReadahead(cont.elementsOffset(), cont.header.count,
+                     static_cast<std::ptrdiff_t>(index), 2 * READAHEAD);
+}
+
+bool PagedMagicalContainer::AscendingIterator::operator==(
+    const AscendingIterator &other) const {
+  return currentIndex == other.currentIndex;
+}
+
+bool PagedMagicalContainer::AscendingIterator::operator!=(
+    const AscendingIterator &other) const {
+  return !(*this == other);
+}
+
+bool PagedMagicalContainer::AscendingIterator::operator>(
+    const AscendingIterator &other) const {
+  return currentIndex > other.currentIndex;
+}
+
+bool PagedMagicalContainer::AscendingIterator::operator<(
+    const AscendingIterator &other) const {
+  return currentIndex < other.currentIndex;
+}
+
+int PagedMagicalContainer::AscendingIterator::operator*() const {
+  if (currentIndex >= container->header.count) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  return container->elementAt(currentIndex);
+}
+
+PagedMagicalContainer::AscendingIterator &
+PagedMagicalContainer::AscendingIterator::operator++() {
+  if (currentIndex >= container->header.count) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++currentIndex;
+  if (currentIndex % READAHEAD == 0) { // entered a window: fetch the next
+    container->hintReadahead(
+        container->elementsOffset(), container->header.count,
+        static_cast<std::ptrdiff_t>(currentIndex + READAHEAD), READAHEAD);
+  }
+  return *this;
+}
+
+PagedMagicalContainer::AscendingIterator
+PagedMagicalContainer::AscendingIterator::begin() const {
+  return AscendingIterator(*container, 0);
+}
+
+PagedMagicalContainer::AscendingIterator
+PagedMagicalContainer::AscendingIterator::end() const {
+  return AscendingIterator(*container, container->header.count);
+}
+
+// SideCrossIterator
+// Reads ahead at both ends: upwards from the front and downwards from the back
+PagedMagicalContainer::SideCrossIterator::SideCrossIterator(
+    const PagedMagicalContainer &cont, std::size_t index)
+    : container(&cont), currentIndex(index) {
+  const auto taken = static_cast<std::ptrdiff_t>(index / 2);
+  const auto size = static_cast<std::ptrdiff_t>(cont.header.count);
+  const auto window = static_cast<std::ptrdiff_t>(2 * READAHEAD);
+  if (index < cont.header.count) { // not for end()
+    cont.hintReadahead(cont.elementsOffset(), cont.header.count, taken,
+                       2 * READAHEAD);
+    cont.hintReadahead(cont.elementsOffset(), cont.header.count,
+                       size - taken - window, 2 * READAHEAD);
+  }
+}
+
+bool PagedMagicalContainer::SideCrossIterator::operator==(
+    const SideCrossIterator &other) const {
+  return currentIndex == other.currentIndex;
+}
+
+bool PagedMagicalContainer::SideCrossIterator::operator!=(
+    const SideCrossIterator &other) const {
+  return !(*this == other);
+}
+
+bool PagedMagicalContainer::SideCrossIterator::operator>(
+    const SideCrossIterator &other) const {
+  return currentIndex > other.currentIndex;
+}
+
+bool PagedMagicalContainer::SideCrossIterator::operator<(
+    const SideCrossIterator &other) const {
+  return currentIndex < other.currentIndex;
+}
+
+int PagedMagicalContainer::SideCrossIterator::operator*() const {
+  const std::size_t size = container->header.count;
+  if (currentIndex >= size) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  if (currentIndex % 2 == 0)
+    return container->elementAt(currentIndex / 2);
+  return container->elementAt(size - 1 - currentIndex / 2);
+}
+
+PagedMagicalContainer::SideCrossIterator &
+PagedMagicalContainer::SideCrossIterator::operator++() {
+  if (currentIndex >= container->header.count) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++currentIndex;
+  if (currentIndex % (2 * READAHEAD) == 0) {
+    const auto taken = static_cast<std::ptrdiff_t>(currentIndex / 2);
+    const auto size = static_cast<std::ptrdiff_t>(container->header.count);
+    const auto window = static_cast<std::ptrdiff_t>(READAHEAD);
+    container->hintReadahead(container->elementsOffset(),
+                             container->header.count, taken + window,
+                             READAHEAD);
+    container->hintReadahead(container->elementsOffset(),
+                             container->header.count,
+                             size - taken - 2 * window, READAHEAD);
+  }
+  return *this;
+}
+
+PagedMagicalContainer::SideCrossIterator
+PagedMagicalContainer::SideCrossIterator::begin() const {
+  return SideCrossIterator(*container, 0);
+}
+
+PagedMagicalContainer::SideCrossIterator
+PagedMagicalContainer::SideCrossIterator::end() const {
+  return SideCrossIterator(*container, container->header.count);
+}
+
+// PrimeIterator
+// Reads ahead in the prime index; the elements it points to are sparse and
+// left to the kernel
+PagedMagicalContainer::PrimeIterator::PrimeIterator(
+    const PagedMagicalContainer &cont, std::size_t index)
+    : container(&cont), currentIndex(index) {
+  cont.hintReadahead(cont.primesOffset(), cont.header.primeCount,
+                     static_cast<std::ptrdiff_t>(index), 2 * READAHEAD);
+}
+
+bool PagedMagicalContainer::PrimeIterator::operator==(
+    const PrimeIterator &other) const {
+  return currentIndex == other.currentIndex;
+}
+
+bool PagedMagicalContainer::PrimeIterator::operator!=(
+    const PrimeIterator &other) const {
+  return !(*this == other);
+}
+
+bool PagedMagicalContainer::PrimeIterator::operator>(
+    const PrimeIterator &other) const {
+  return currentIndex > other.currentIndex;
+}
+
+bool PagedMagicalContainer::PrimeIterator::operator<(
+    const PrimeIterator &other) const {
+  return currentIndex < other.currentIndex;
+}
+
+// A corrupt prime index must not read outside the elements
+int PagedMagicalContainer::PrimeIterator::operator*() const {
+  if (currentIndex >= container->header.primeCount) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  const std::size_t position = container->primePosition(currentIndex);
+  if (position >= container->header.count) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  return container->elementAt(position);
+}
+
+PagedMagicalContainer::PrimeIterator &
+PagedMagicalContainer::PrimeIterator::operator++() {
+  if (currentIndex >= container->header.primeCount) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++currentIndex;
+  if (currentIndex % READAHEAD == 0) {
+    container->hintReadahead(
+        container->primesOffset(), container->header.primeCount,
+        static_cast<std::ptrdiff_t>(currentIndex + READAHEAD), READAHEAD);
+  }
+  return *this;
+}
+
+PagedMagicalContainer::PrimeIterator
+PagedMagicalContainer::PrimeIterator::begin() const {
+  return PrimeIterator(*container, 0);
+}
+
+PagedMagicalContainer::PrimeIterator
+PagedMagicalContainer::PrimeIterator::end() const {
+  return PrimeIterator(*container, container->header.primeCount);
+}
+
+} // namespace ariel
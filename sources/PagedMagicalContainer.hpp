@@ -0,0 +1,174 @@
+#ifndef PAGEDMAGICALCONTAINER_HPP
+#define PAGEDMAGICALCONTAINER_HPP
+
+#include "MappedMagicalContainer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ariel {
+
+// Read-only container over a snapshot file (see MappedMagicalContainer.hpp)
+// that reads it page by page into a buffer pool of fixed size, instead of
+// mapping it. Memory use is the pool, however large the file; pages are
+// replaced by the CLOCK policy, an approximation of LRU that needs one bit
+// per page and no list to update on a hit.
+//
+// Iterators ask the kernel (posix_fadvise WILLNEED) to read the pages they
+// will need next into its page cache, so pool misses during a scan are mostly
+// served without waiting on the disk: ahead of an ascending or prime scan,
+// and at both ends of a side-cross one. Pages enter the pool only when read.
+//
+// Reads fill the shared pool, so even const use is for one thread at a time.
+class PagedMagicalContainer {
+public:
+  static constexpr std::size_t PAGE_SIZE = 4096;
+
+  struct Metrics {
+    std::uint64_t hits = 0;       // page found in the pool
+    std::uint64_t misses = 0;     // page read from the file
+    std::uint64_t evictions = 0;  // misses that replaced a page
+    // Pages the kernel was asked to read ahead into its page cache; a hint,
+    // so they are neither read here nor placed in the pool
+    std::uint64_t readaheadHinted = 0;
+
+    double hitRate() const; // 0 before the first access
+  };
+
+private:
+  struct Frame {
+    std::uint64_t page = 0;
+    bool used = false;
+    bool referenced = false; // cleared as the clock hand passes
+  };
+
+  struct Pool {
+    std::vector<char> memory; // frames.size() pages
+    std::vector<Frame> frames;
+    std::unordered_map<std::uint64_t, std::size_t> resident; // page to frame
+    std::size_t hand = 0;
+    std::size_t lastFrame = 0; // repeated reads of one page skip the lookup
+    bool lastValid = false;
+    Metrics metrics;
+  };
+
+  int file = -1;
+  MappedMagicalContainer::Header header{};
+  mutable Pool pool;
+
+  const char *fetch(std::uint64_t page) const;
+  std::uint32_t word(std::uint64_t offset) const;
+  int elementAt(std::size_t index) const;
+  std::size_t primePosition(std::size_t index) const;
+
+  // Starts reading words [first, first + count) of the array at byte offset
+  // base, clipped to its size words, into the page cache
+  void hintReadahead(std::uint64_t base, std::uint64_t size,
+                     std::ptrdiff_t first, std::size_t count) const;
+  std::uint64_t elementsOffset() const;
+  std::uint64_t primesOffset() const;
+
+public:
+  // Throws as MappedMagicalContainer does; poolPages is raised to 1 if 0
+  explicit PagedMagicalContainer(const std::string &path,
+                                 std::size_t poolPages = 256);
+  PagedMagicalContainer(PagedMagicalContainer &&other) noexcept;
+  PagedMagicalContainer &operator=(PagedMagicalContainer &&other) noexcept;
+  PagedMagicalContainer(const PagedMagicalContainer &) = delete;
+  PagedMagicalContainer &operator=(const PagedMagicalContainer &) = delete;
+  ~PagedMagicalContainer();
+
+  int size() const;
+  std::size_t primeCount() const;
+  bool contains(int element) const; // O(log n) page reads at most
+
+  std::size_t poolPages() const;
+  Metrics metrics() const;
+  void resetMetrics();
+
+  class AscendingIterator {
+  private:
+    const PagedMagicalContainer *container;
+    std::size_t currentIndex;
+
+  public:
+    // Constructor
+    AscendingIterator(const PagedMagicalContainer &cont,
+                      std::size_t index = 0);
+
+    // Comparison operators
+    bool operator==(const AscendingIterator &other) const;
+    bool operator!=(const AscendingIterator &other) const;
+    bool operator>(const AscendingIterator &other) const;
+    bool operator<(const AscendingIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    AscendingIterator &operator++();
+
+    // Iterator begin and end functions
+    AscendingIterator begin() const;
+    AscendingIterator end() const;
+  };
+
+  class SideCrossIterator {
+  private:
+    const PagedMagicalContainer *container;
+    std::size_t currentIndex; // steps taken, alternating front and back
+
+  public:
+    // Constructor
+    SideCrossIterator(const PagedMagicalContainer &cont,
+                      std::size_t index = 0);
+
+    // Comparison operators
+    bool operator==(const SideCrossIterator &other) const;
+    bool operator!=(const SideCrossIterator &other) const;
+    bool operator>(const SideCrossIterator &other) const;
+    bool operator<(const SideCrossIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    SideCrossIterator &operator++();
+
+    // Iterator begin and end functions
+    SideCrossIterator begin() const;
+    SideCrossIterator end() const;
+  };
+
+  class PrimeIterator {
+  private:
+    const PagedMagicalContainer *container;
+    std::size_t currentIndex;
+
+  public:
+    // Constructor
+    PrimeIterator(const PagedMagicalContainer &cont, std::size_t index = 0);
+
+    // Comparison operators
+    bool operator==(const PrimeIterator &other) const;
+    bool operator!=(const PrimeIterator &other) const;
+    bool operator>(const PrimeIterator &other) const;
+    bool operator<(const PrimeIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    PrimeIterator &operator++();
+
+    // Iterator begin and end functions
+    PrimeIterator begin() const;
+    PrimeIterator end() const;
+  };
+};
+
+} // namespace ariel
+
+#endif /* PAGEDMAGICALCONTAINER_HPP */
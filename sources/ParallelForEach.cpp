@@ -0,0 +1,111 @@
+#include "ParallelForEach.hpp"
+
+namespace ariel {
+
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+  std::size_t count =
+      threads != 0 ? threads : std::max(1U, std::thread::hardware_concurrency());
+  for (std::size_t i = 0; i < count; ++i) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    workers.emplace_back([this, i] { workerLoop(i); });
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+std::size_t WorkStealingPool::threadCount() const { return workers.size(); }
+
+bool WorkStealingPool::runOne(std::size_t self) {
+  std::function<void()> task;
+  for (std::size_t i = 0; i < queues.size() && !task; ++i) {
+    Queue &queue = *queues[(self + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      continue;
+    if (i == 0) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+  }
+  if (!task)
+    return false;
+  --queued;
+  task();
+  return true;
+}
+
+void WorkStealingPool::workerLoop(std::size_t self) {
+  for (;;) {
+    if (runOne(self))
+      continue;
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+    if (stopping)
+      return;
+  }
+}
+
+void WorkStealingPool::runAll(std::vector<std::function<void()>> tasks) {
+  if (tasks.empty())
+    return;
+
+  std::atomic<std::size_t> remaining{tasks.size()};
+  std::mutex failureMutex;
+  std::exception_ptr failure;
+
+  // Count the tasks before any worker can take one, then deal them out
+  // round-robin; stealing evens out what is left
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    queued += tasks.size();
+  }
+  for (std::size_t i = 0; i < tasks.size(); ++i) {
+    Queue &queue = *queues[i % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.emplace_back(
+        [&, task = std::move(tasks[i])] {
+          try {
+            task();
+          } catch (...) {
+            std::lock_guard<std::mutex> failureLock(failureMutex);
+            if (!failure) {
+              failure = std::current_exception();
+            }
+          }
+          --remaining;
+        });
+  }
+  wake.notify_all();
+
+  // Help instead of blocking, which also keeps nested calls from deadlocking
+  std::size_t self = 0;
+  while (remaining.load() > 0) {
+    if (!runOne(self++ % queues.size())) {
+      std::this_thread::yield();
+    }
+  }
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+}
+
+WorkStealingPool &WorkStealingPool::shared() {
+  static WorkStealingPool pool;
+  return pool;
+}
+
+} // namespace ariel
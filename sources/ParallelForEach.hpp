@@ -0,0 +1,166 @@
+#ifndef PARALLELFOREACH_HPP
+#define PARALLELFOREACH_HPP
+
+#include "MagicalContainer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace ariel {
+
+// Fixed-size pool where every worker owns a deque: it takes work from the back
+// of its own and, when that is empty, steals from the front of the others'.
+class WorkStealingPool {
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+  std::atomic<std::size_t> queued{0};
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+  bool stopping = false;
+
+  // Runs one task, preferring queue self; returns false if all were empty
+  bool runOne(std::size_t self);
+  void workerLoop(std::size_t self);
+
+public:
+  // 0 threads means one per hardware thread
+  explicit WorkStealingPool(unsigned threads = 0);
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+  ~WorkStealingPool();
+
+  std::size_t threadCount() const;
+
+  // Runs every task and returns once all have finished; the calling thread
+  // helps. The first exception thrown by a task is rethrown here.
+  void runAll(std::vector<std::function<void()>> tasks);
+
+  // Process-wide pool, created on first use
+  static WorkStealingPool &shared();
+};
+
+namespace detail {
+
+// Elements per task. Fixed, so chunk boundaries and therefore reduction
+// order do not depend on the thread count.
+constexpr std::size_t PARALLEL_CHUNK = 4096;
+
+inline std::size_t traversalLength(const MagicalContainer &container,
+                                   TraversalOrder order) {
+  return order == TraversalOrder::Prime
+             ? container.primeCount()
+             : static_cast<std::size_t>(container.size());
+}
+
+// Calls fn on positions [begin, end) of the traversal, in traversal order
+template <typename Fn>
+void visitRange(MagicalContainer &container, TraversalOrder order,
+                std::size_t begin, std::size_t end, Fn &fn) {
+  switch (order) {
+  case TraversalOrder::Ascending: {
+    MagicalContainer::AscendingIterator it(container, begin);
+    for (std::size_t i = begin; i < end; ++i, ++it) {
+      fn(*it);
+    }
+    break;
+  }
+  case TraversalOrder::SideCross: {
+    // Position k is the k/2-th element from the front (even k) or back (odd k)
+    MagicalContainer::SideCrossIterator it(container, begin / 2,
+                                           begin % 2 == 1);
+    for (std::size_t i = begin; i < end; ++i, ++it) {
+      fn(*it);
+    }
+    break;
+  }
+  case TraversalOrder::Prime: {
+    MagicalContainer::PrimeIterator it(container, begin);
+    for (std::size_t i = begin; i < end; ++i, ++it) {
+      fn(*it);
+    }
+    break;
+  }
+  }
+}
+
+// Runs chunkFn(chunk, begin, end) for every chunk of the traversal on pool
+template <typename ChunkFn>
+void forEachChunk(MagicalContainer &container, TraversalOrder order,
+                  WorkStealingPool &pool, ChunkFn chunkFn) {
+  const std::size_t length = traversalLength(container, order);
+  std::vector<std::function<void()>> tasks;
+  tasks.reserve((length + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK);
+  for (std::size_t begin = 0; begin < length; begin += PARALLEL_CHUNK) {
+    std::size_t end = std::min(length, begin + PARALLEL_CHUNK);
+    tasks.emplace_back([&chunkFn, chunk = tasks.size(), begin, end] {
+      chunkFn(chunk, begin, end);
+    });
+  }
+  pool.runAll(std::move(tasks));
+}
+
+} // namespace detail
+
+// Calls fn(element) for every element of the traversal, in parallel. Calls
+// within one chunk follow traversal order; chunks run in any order and fn is
+// shared between threads. The container must not be modified until this
+// returns.
+template <typename Fn>
+void parallel_for_each(MagicalContainer &container, TraversalOrder order,
+                       Fn fn,
+                       WorkStealingPool &pool = WorkStealingPool::shared()) {
+  detail::forEachChunk(container, order, pool,
+                       [&](std::size_t, std::size_t begin, std::size_t end) {
+                         detail::visitRange(container, order, begin, end, fn);
+                       });
+}
+
+// Reduces map(element) with combine in traversal order: each chunk is folded
+// on its own, then the chunk results are folded into init left to right. The
+// grouping depends only on the container, so the result is the same for any
+// thread count or schedule, even when combine is not associative (floating
+// point sums).
+template <typename T, typename Map, typename Combine>
+T parallel_reduce(MagicalContainer &container, TraversalOrder order, T init,
+                  Map map, Combine combine,
+                  WorkStealingPool &pool = WorkStealingPool::shared()) {
+  const std::size_t length = detail::traversalLength(container, order);
+  std::vector<std::optional<T>> partials(
+      (length + detail::PARALLEL_CHUNK - 1) / detail::PARALLEL_CHUNK);
+  detail::forEachChunk(
+      container, order, pool,
+      [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+        std::optional<T> &partial = partials[chunk];
+        auto accumulate = [&](int element) {
+          if (partial) {
+            partial = combine(std::move(*partial), map(element));
+          } else {
+            partial = map(element);
+          }
+        };
+        detail::visitRange(container, order, begin, end, accumulate);
+      });
+  for (std::optional<T> &partial : partials) {
+    init = combine(std::move(init), std::move(*partial));
+  }
+  return init;
+}
+
+} // namespace ariel
+
+#endif /* PARALLELFOREACH_HPP */
@@ -0,0 +1,336 @@
+#include "PersistentMagicalContainer.hpp"
+#include "MagicalContainer.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace ariel {
+
+namespace {
+
+// Mixes the bits of value so priorities look random but stay reproducible
+std::uint32_t priorityOf(int value) {
+  auto x = static_cast<std::uint32_t>(value);
+  x ^= x >> 16;
+  x *= 0x7feb352dU;
+  x ^= x >> 15;
+  x *= 0x846ca68bU;
+  x ^= x >> 16;
+  return x;
+}
+
+} // namespace
+
+PersistentMagicalContainer::Link
+PersistentMagicalContainer::makeNode(const Node &fields, Link left,
+                                     Link right) {
+  Node node{fields.value, fields.priority, fields.prime, 1,
+            fields.prime ? 1U : 0U, std::move(left), std::move(right)};
+  for (const Link *child : {&node.left, &node.right}) {
+    if (*child) {
+      node.count += (*child)->count;
+      node.primes += (*child)->primes;
+    }
+  }
+  return std::make_shared<const Node>(std::move(node));
+}
+
+// Every value in low is below every value in high
+PersistentMagicalContainer::Link
+PersistentMagicalContainer::merge(const Link &low, const Link &high) {
+  if (!low)
+    return high;
+  if (!high)
+    return low;
+  if (low->priority > high->priority) {
+    return makeNode(*low, low->left, merge(low->right, high));
+  }
+  return makeNode(*high, merge(low, high->left), high->right);
+}
+
+std::pair<PersistentMagicalContainer::Link, PersistentMagicalContainer::Link>
+PersistentMagicalContainer::split(const Link &node, int key, bool inclusive) {
+  if (!node)
+    return {};
+  if (inclusive ? node->value <= key : node->value < key) {
+    auto [low, high] = split(node->right, key, inclusive);
+    return {makeNode(*node, node->left, std::move(low)), std::move(high)};
+  }
+  auto [low, high] = split(node->left, key, inclusive);
+  return {std::move(low), makeNode(*node, std::move(high), node->right)};
+}
+
+void PersistentMagicalContainer::publish(Link root) {
+  versions.push_back(std::move(root));
+  while (versions.size() > retention) {
+    versions.pop_front();
+    ++oldest;
+  }
+}
+
+PersistentMagicalContainer::PersistentMagicalContainer(std::size_t retention)
+    : versions(1), retention(std::max<std::size_t>(retention, 1)) {}
+
+void PersistentMagicalContainer::addElement(int element) {
+  if (contains(element))
+    return;
+  auto [low, high] = split(versions.back(), element, false);
+  Node leaf{element, priorityOf(element), isPrime(element), 1, 0, nullptr,
+            nullptr};
+  publish(merge(merge(low, makeNode(leaf, nullptr, nullptr)), high));
+}
+
+void PersistentMagicalContainer::removeElement(int element) {
+  if (!contains(element)) {
+    throw std::runtime_error("Element not found");
+  }
+  auto [low, rest] = split(versions.back(), element, false);
+  publish(merge(low, split(rest, element, true).second));
+}
+
+int PersistentMagicalContainer::size() const {
+  return Version(versions.back()).size();
+}
+
+bool PersistentMagicalContainer::contains(int element) const {
+  return Version(versions.back()).contains(element);
+}
+
+void PersistentMagicalContainer::setRetention(std::size_t retention) {
+  this->retention = std::max<std::size_t>(retention, 1);
+  while (versions.size() > this->retention) {
+    versions.pop_front();
+    ++oldest;
+  }
+}
+
+std::size_t PersistentMagicalContainer::currentVersion() const {
+  return oldest + versions.size() - 1;
+}
+
+std::size_t PersistentMagicalContainer::oldestVersion() const {
+  return oldest;
+}
+
+PersistentMagicalContainer::Version
+PersistentMagicalContainer::version(std::size_t number) const {
+  if (number < oldest || number > currentVersion()) {
+    throw std::runtime_error("Version not retained");
+  }
+  return Version(versions[number - oldest]);
+}
+
+PersistentMagicalContainer::Version
+PersistentMagicalContainer::versionsAgo(std::size_t steps) const {
+  if (steps > currentVersion()) {
+    throw std::runtime_error("Version not retained");
+  }
+  return version(currentVersion() - steps);
+}
+
+// Version
+PersistentMagicalContainer::Version::Version(Link root)
+    : root(std::move(root)) {}
+
+int PersistentMagicalContainer::Version::size() const {
+  return root ? static_cast<int>(root->count) : 0;
+}
+
+std::size_t PersistentMagicalContainer::Version::primeCount() const {
+  return root ? root->primes : 0;
+}
+
+bool PersistentMagicalContainer::Version::contains(int element) const {
+  for (const Node *node = root.get(); node != nullptr;) {
+    if (element == node->value)
+      return true;
+    node = element < node->value ? node->left.get() : node->right.get();
+  }
+  return false;
+}
+
+int PersistentMagicalContainer::Version::at(std::size_t index) const {
+  if (index >= static_cast<std::size_t>(size())) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  const Node *node = root.get();
+  for (;;) {
+    std::size_t before = node->left ? node->left->count : 0;
+    if (index < before) {
+      node = node->left.get();
+    } else if (index == before) {
+      return node->value;
+    } else {
+      index -= before + 1;
+      node = node->right.get();
+    }
+  }
+}
+
+int PersistentMagicalContainer::Version::primeAt(std::size_t index) const {
+  if (index >= primeCount()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  const Node *node = root.get();
+  for (;;) {
+    std::size_t before = node->left ? node->left->primes : 0;
+    if (index < before) {
+      node = node->left.get();
+    } else if (index == before && node->prime) {
+      return node->value;
+    } else {
+      index -= before + (node->prime ? 1U : 0U);
+      node = node->right.get();
+    }
+  }
+}
+
+// AscendingIterator
+PersistentMagicalContainer::AscendingIterator::AscendingIterator(
+    const Version &version, std::size_t index)
+    : version(version), currentIndex(index) {}
+
+bool PersistentMagicalContainer::AscendingIterator::operator==(
+    const AscendingIterator &other) const {
+  return currentIndex == other.currentIndex;
+}
+
+bool PersistentMagicalContainer::AscendingIterator::operator!=(
+    const AscendingIterator &other) const {
+  return !(*this == other);
+}
+
+bool PersistentMagicalContainer::AscendingIterator::operator>(
+    const AscendingIterator &other) const {
+  return currentIndex > other.currentIndex;
+}
+
+bool PersistentMagicalContainer::AscendingIterator::operator<(
+    const AscendingIterator &other) const {
+  return currentIndex < other.currentIndex;
+}
+
+int PersistentMagicalContainer::AscendingIterator::operator*() const {
+  return version.at(currentIndex);
+}
+
+PersistentMagicalContainer::AscendingIterator &
+PersistentMagicalContainer::AscendingIterator::operator++() {
+  if (currentIndex >= static_cast<std::size_t>(version.size())) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++currentIndex;
+  return *this;
+}
+
+PersistentMagicalContainer::AscendingIterator
+PersistentMagicalContainer::AscendingIterator::begin() const {
+  return AscendingIterator(version, 0);
+}
+
+PersistentMagicalContainer::AscendingIterator
+PersistentMagicalContainer::AscendingIterator::end() const {
+  return AscendingIterator(version, static_cast<std::size_t>(version.size()));
+}
+
+// SideCrossIterator
+PersistentMagicalContainer::SideCrossIterator::SideCrossIterator(
+    const Version &version, std::size_t position)
+    : version(version), position(position) {}
+
+bool PersistentMagicalContainer::SideCrossIterator::operator==(
+    const SideCrossIterator &other) const {
+  return position == other.position;
+}
+
+bool PersistentMagicalContainer::SideCrossIterator::operator!=(
+    const SideCrossIterator &other) const {
+  return !(*this == other);
+}
+
+bool PersistentMagicalContainer::SideCrossIterator::operator>(
+    const SideCrossIterator &other) const {
+  return position > other.position;
+}
+
+bool PersistentMagicalContainer::SideCrossIterator::operator<(
+    const SideCrossIterator &other) const {
+  return position < other.position;
+}
+
+int PersistentMagicalContainer::SideCrossIterator::operator*() const {
+  const auto count = static_cast<std::size_t>(version.size());
+  if (position >= count) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  return version.at(position % 2 == 0 ? position / 2
+                                      : count - 1 - position / 2);
+}
+
+PersistentMagicalContainer::SideCrossIterator &
+PersistentMagicalContainer::SideCrossIterator::operator++() {
+  if (position >= static_cast<std::size_t>(version.size())) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++position;
+  return *this;
+}
+
+PersistentMagicalContainer::SideCrossIterator
+PersistentMagicalContainer::SideCrossIterator::begin() const {
+  return SideCrossIterator(version, 0);
+}
+
+PersistentMagicalContainer::SideCrossIterator
+PersistentMagicalContainer::SideCrossIterator::end() const {
+  return SideCrossIterator(version, static_cast<std::size_t>(version.size()));
+}
+
+// PrimeIterator
+PersistentMagicalContainer::PrimeIterator::PrimeIterator(const Version &version,
+                                                         std::size_t index)
+    : version(version), currentIndex(index) {}
+
+bool PersistentMagicalContainer::PrimeIterator::operator==(
+    const PrimeIterator &other) const {
+  return currentIndex == other.currentIndex;
+}
+
+bool PersistentMagicalContainer::PrimeIterator::operator!=(
+    const PrimeIterator &other) const {
+  return !(*this == other);
+}
+
+bool PersistentMagicalContainer::PrimeIterator::operator>(
+    const PrimeIterator &other) const {
+  return currentIndex > other.currentIndex;
+}
+
+bool PersistentMagicalContainer::PrimeIterator::operator<(
+    const PrimeIterator &other) const {
+  return currentIndex < other.currentIndex;
+}
+
+int PersistentMagicalContainer::PrimeIterator::operator*() const {
+  return version.primeAt(currentIndex);
+}
+
+PersistentMagicalContainer::PrimeIterator &
+PersistentMagicalContainer::PrimeIterator::operator++() {
+  if (currentIndex >= version.primeCount()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++currentIndex;
+  return *this;
+}
+
+PersistentMagicalContainer::PrimeIterator
+PersistentMagicalContainer::PrimeIterator::begin() const {
+  return PrimeIterator(version, 0);
+}
+
+PersistentMagicalContainer::PrimeIterator
+PersistentMagicalContainer::PrimeIterator::end() const {
+  return PrimeIterator(version, version.primeCount());
+}
+
+} // namespace ariel
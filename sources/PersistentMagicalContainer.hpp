@@ -0,0 +1,170 @@
+#ifndef PERSISTENTMAGICALCONTAINER_HPP
+#define PERSISTENTMAGICALCONTAINER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+
+namespace ariel {
+
+// MagicalContainer that keeps its past. Elements live in a persistent treap
+// whose nodes are never changed: a mutation copies the O(log n) nodes on the
+// path it touches and shares the rest with the previous version. The last
+// retention versions stay reachable by number; a Version (or an iterator over
+// one) keeps its tree alive even after it leaves the window.
+//
+// Node priorities are a hash of the value, so a set of elements always has
+// the same shape whatever order it was built in.
+class PersistentMagicalContainer {
+private:
+  struct Node;
+  using Link = std::shared_ptr<const Node>;
+
+  struct Node {
+    int value;
+    std::uint32_t priority;
+    bool prime;
+    std::size_t count;  // elements in this subtree
+    std::size_t primes; // primes in this subtree
+    Link left;
+    Link right;
+  };
+
+  std::deque<Link> versions; // oldest retained first; back is current
+  std::size_t oldest = 0;    // number of versions.front()
+  std::size_t retention;
+
+  static Link makeNode(const Node &fields, Link left, Link right);
+  static Link merge(const Link &low, const Link &high);
+  // Splits into values < key and values >= key (<= key if inclusive)
+  static std::pair<Link, Link> split(const Link &node, int key,
+                                     bool inclusive);
+  void publish(Link root);
+
+public:
+  // Versions kept reachable, counting the current one; at least 1
+  explicit PersistentMagicalContainer(std::size_t retention = 64);
+
+  // Each successful call makes a new version in O(log n) time and space;
+  // adding a present element changes nothing
+  void addElement(int element);
+  void removeElement(int element);
+  int size() const;
+  bool contains(int element) const;
+
+  void setRetention(std::size_t retention);
+
+  // Numbers of the current and oldest retained versions; the empty container
+  // is version 0
+  std::size_t currentVersion() const;
+  std::size_t oldestVersion() const;
+
+  // Immutable state of the container after some mutation
+  class Version {
+  private:
+    Link root;
+
+    friend class PersistentMagicalContainer;
+    explicit Version(Link root);
+
+  public:
+    int size() const;
+    std::size_t primeCount() const;
+    bool contains(int element) const;
+
+    // index-th element in ascending order / index-th prime; O(log n)
+    int at(std::size_t index) const;
+    int primeAt(std::size_t index) const;
+  };
+
+  // Throws if the version is not (or no longer) retained
+  Version version(std::size_t number) const;
+
+  // The version steps mutations before the current one
+  Version versionsAgo(std::size_t steps) const;
+
+  // Iterators hold their Version; each step is an O(log n) descent
+  class AscendingIterator {
+  private:
+    Version version;
+    std::size_t currentIndex;
+
+  public:
+    // Constructor
+    AscendingIterator(const Version &version, std::size_t index = 0);
+
+    // Comparison operators
+    bool operator==(const AscendingIterator &other) const;
+    bool operator!=(const AscendingIterator &other) const;
+    bool operator>(const AscendingIterator &other) const;
+    bool operator<(const AscendingIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    AscendingIterator &operator++();
+
+    // Iterator begin and end functions
+    AscendingIterator begin() const;
+    AscendingIterator end() const;
+  };
+
+  class SideCrossIterator {
+  private:
+    Version version;
+    std::size_t position; // front elements at even positions, back at odd
+
+  public:
+    // Constructor
+    SideCrossIterator(const Version &version, std::size_t position = 0);
+
+    // Comparison operators
+    bool operator==(const SideCrossIterator &other) const;
+    bool operator!=(const SideCrossIterator &other) const;
+    bool operator>(const SideCrossIterator &other) const;
+    bool operator<(const SideCrossIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    SideCrossIterator &operator++();
+
+    // Iterator begin and end functions
+    SideCrossIterator begin() const;
+    SideCrossIterator end() const;
+  };
+
+  class PrimeIterator {
+  private:
+    Version version;
+    std::size_t currentIndex;
+
+  public:
+    // Constructor
+    PrimeIterator(const Version &version, std::size_t index = 0);
+
+    // Comparison operators
+    bool operator==(const PrimeIterator &other) const;
+    bool operator!=(const PrimeIterator &other) const;
+    bool operator>(const PrimeIterator &other) const;
+    bool operator<(const PrimeIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    PrimeIterator &operator++();
+
+    // Iterator begin and end functions
+    PrimeIterator begin() const;
+    PrimeIterator end() const;
+  };
+};
+
+} // namespace ariel
+
+#endif /* PERSISTENTMAGICALCONTAINER_HPP */
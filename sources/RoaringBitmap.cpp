@@ -0,0 +1,284 @@
+#include "RoaringBitmap.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace ariel {
+
+namespace {
+
+constexpr std::uint32_t CHUNK_SPAN = 65536;
+
+// Primes up to sqrt(2^31), enough to sieve any chunk of the int range
+const std::vector<std::uint32_t> &smallPrimes() {
+  static const std::vector<std::uint32_t> primes = [] {
+    const std::uint32_t limit = 46341;
+    std::vector<bool> composite(limit + 1, false);
+    std::vector<std::uint32_t> result;
+    for (std::uint32_t i = 2; i <= limit; ++i) {
+      if (composite[i])
+        continue;
+      result.push_back(i);
+      for (std::uint64_t j = std::uint64_t{i} * i; j <= limit; j += i) {
+        composite[j] = true;
+      }
+    }
+    return result;
+  }();
+  return primes;
+}
+
+// Drops a vector's storage, unlike assigning {} which keeps the capacity
+template <typename T> void release(std::vector<T> &values) {
+  std::vector<T>().swap(values);
+}
+
+void clearBit(std::vector<std::uint64_t> &words, std::uint32_t low) {
+  words[low >> 6U] &= ~(std::uint64_t{1} << (low & 63U));
+}
+
+} // namespace
+
+RoaringBitmap::Chunk *RoaringBitmap::findChunk(std::uint16_t key) {
+  auto it = std::lower_bound(
+      chunks.begin(), chunks.end(), key,
+      [](const Chunk &chunk, std::uint16_t k) { return chunk.key < k; });
+  return (it != chunks.end() && it->key == key) ? &*it : nullptr;
+}
+
+const RoaringBitmap::Chunk *RoaringBitmap::findChunk(std::uint16_t key) const {
+  return const_cast<RoaringBitmap *>(this)->findChunk(key);
+}
+
+bool RoaringBitmap::chunkContains(const Chunk &chunk, std::uint16_t low) {
+  switch (chunk.kind) {
+  case Kind::Array:
+    return std::binary_search(chunk.array.begin(), chunk.array.end(), low);
+  case Kind::Bitmap:
+    return ((chunk.words[low >> 6U] >> (low & 63U)) & 1U) != 0;
+  case Kind::Run: {
+    auto it = std::upper_bound(
+        chunk.runs.begin(), chunk.runs.end(), low,
+        [](std::uint16_t v, const auto &run) { return v < run.first; });
+    if (it == chunk.runs.begin())
+      return false;
+    --it;
+    return std::uint32_t{low} <= std::uint32_t{it->first} + it->second;
+  }
+  }
+  return false;
+}
+
+void RoaringBitmap::toWords(const Chunk &chunk, std::uint64_t *out) {
+  switch (chunk.kind) {
+  case Kind::Bitmap:
+    std::copy(chunk.words.begin(), chunk.words.end(), out);
+    return;
+  case Kind::Array:
+    std::fill(out, out + WORDS_PER_CHUNK, 0);
+    for (std::uint16_t low : chunk.array) {
+      out[low >> 6U] |= std::uint64_t{1} << (low & 63U);
+    }
+    return;
+  case Kind::Run:
+    std::fill(out, out + WORDS_PER_CHUNK, 0);
+    for (const auto &run : chunk.runs) {
+      std::uint32_t last = std::uint32_t{run.first} + run.second;
+      for (std::uint32_t low = run.first; low <= last; ++low) {
+        out[low >> 6U] |= std::uint64_t{1} << (low & 63U);
+      }
+    }
+    return;
+  }
+}
+
+void RoaringBitmap::toBitmap(Chunk &chunk) {
+  std::vector<std::uint64_t> words(WORDS_PER_CHUNK);
+  toWords(chunk, words.data());
+  chunk.words = std::move(words);
+  release(chunk.array);
+  release(chunk.runs);
+  chunk.kind = Kind::Bitmap;
+}
+
+void RoaringBitmap::toArray(Chunk &chunk) {
+  std::vector<std::uint64_t> words(WORDS_PER_CHUNK);
+  toWords(chunk, words.data());
+  std::vector<std::uint16_t> array;
+  array.reserve(chunk.cardinality);
+  for (std::size_t i = 0; i < WORDS_PER_CHUNK; ++i) {
+    std::uint64_t word = words[i];
+    while (word != 0) {
+      array.push_back(static_cast<std::uint16_t>(
+          i * 64 + static_cast<std::size_t>(std::countr_zero(word))));
+      word &= word - 1;
+    }
+  }
+  chunk.array = std::move(array);
+  release(chunk.words);
+  release(chunk.runs);
+  chunk.kind = Kind::Array;
+}
+
+void RoaringBitmap::expandRuns(Chunk &chunk) {
+  if (chunk.cardinality > ARRAY_LIMIT) {
+    toBitmap(chunk);
+  } else {
+    toArray(chunk);
+  }
+}
+
+// Segmented sieve over [base, base + 2^16), odd numbers only: base is even,
+// so the odd values are the odd bits, and each prime's even multiples are
+// skipped.
+void RoaringBitmap::primeMask(std::uint16_t key, std::uint64_t *mask) {
+  std::fill(mask, mask + WORDS_PER_CHUNK, 0xaaaaaaaaaaaaaaaaULL);
+  const std::uint64_t base = std::uint64_t{key - 0x8000U} << 16U;
+  const std::uint64_t limit = base + CHUNK_SPAN;
+  if (base == 0) {
+    mask[0] &= ~std::uint64_t{2}; // 1 is not prime
+    mask[0] |= std::uint64_t{4};  // 2 is
+  }
+  for (std::uint32_t prime : smallPrimes()) {
+    std::uint64_t p = prime;
+    if (p == 2)
+      continue;
+    if (p * p >= limit)
+      break;
+    std::uint64_t start = std::max(p * p, (base + p - 1) / p * p);
+    if (start % 2 == 0) {
+      start += p;
+    }
+    for (std::uint64_t m = start; m < limit; m += 2 * p) {
+      const auto low = static_cast<std::uint32_t>(m - base);
+      mask[low >> 6U] &= ~(std::uint64_t{1} << (low & 63U));
+    }
+  }
+}
+
+void RoaringBitmap::cachePrimeMask(Chunk &chunk) {
+  if (!chunk.primes.empty() || chunk.key < 0x8000 ||
+      chunk.cardinality <= PRIME_TEST_LIMIT || primeMasks == MAX_PRIME_MASKS)
+    return;
+  chunk.primes.resize(WORDS_PER_CHUNK);
+  primeMask(chunk.key, chunk.primes.data());
+  ++primeMasks;
+}
+
+void RoaringBitmap::addElement(int element) {
+  std::uint32_t bits = encode(element);
+  auto key = static_cast<std::uint16_t>(bits >> 16U);
+  auto low = static_cast<std::uint16_t>(bits & 0xFFFFU);
+
+  auto it = std::lower_bound(
+      chunks.begin(), chunks.end(), key,
+      [](const Chunk &chunk, std::uint16_t k) { return chunk.key < k; });
+  if (it == chunks.end() || it->key != key) {
+    Chunk fresh;
+    fresh.key = key;
+    it = chunks.insert(it, std::move(fresh));
+  }
+  Chunk &chunk = *it;
+  if (chunkContains(chunk, low))
+    return;
+
+  if (chunk.kind == Kind::Run)
+    expandRuns(chunk);
+  if (chunk.kind == Kind::Array && chunk.cardinality >= ARRAY_LIMIT)
+    toBitmap(chunk);
+
+  if (chunk.kind == Kind::Array) {
+    chunk.array.insert(
+        std::lower_bound(chunk.array.begin(), chunk.array.end(), low), low);
+  } else {
+    chunk.words[low >> 6U] |= std::uint64_t{1} << (low & 63U);
+  }
+  ++chunk.cardinality;
+  ++count;
+  cachePrimeMask(chunk);
+}
+
+void RoaringBitmap::removeElement(int element) {
+  std::uint32_t bits = encode(element);
+  auto key = static_cast<std::uint16_t>(bits >> 16U);
+  auto low = static_cast<std::uint16_t>(bits & 0xFFFFU);
+
+  Chunk *chunk = findChunk(key);
+  if (chunk == nullptr || !chunkContains(*chunk, low)) {
+    throw std::runtime_error("Element not found");
+  }
+
+  if (chunk->kind == Kind::Run)
+    expandRuns(*chunk);
+  if (chunk->kind == Kind::Array) {
+    chunk->array.erase(
+        std::lower_bound(chunk->array.begin(), chunk->array.end(), low));
+  } else {
+    clearBit(chunk->words, low);
+  }
+  --chunk->cardinality;
+  --count;
+
+  if (chunk->cardinality == 0) {
+    if (!chunk->primes.empty()) {
+      --primeMasks;
+    }
+    chunks.erase(chunks.begin() + (chunk - chunks.data()));
+  } else if (chunk->kind == Kind::Bitmap &&
+             chunk->cardinality <= ARRAY_LIMIT) {
+    toArray(*chunk);
+  }
+}
+
+bool RoaringBitmap::contains(int element) const {
+  std::uint32_t bits = encode(element);
+  const Chunk *chunk = findChunk(static_cast<std::uint16_t>(bits >> 16U));
+  return chunk != nullptr &&
+         chunkContains(*chunk, static_cast<std::uint16_t>(bits & 0xFFFFU));
+}
+
+int RoaringBitmap::size() const { return static_cast<int>(count); }
+
+void RoaringBitmap::runOptimize() {
+  std::vector<std::uint64_t> words(WORDS_PER_CHUNK);
+  for (Chunk &chunk : chunks) {
+    toWords(chunk, words.data());
+    std::vector<std::pair<std::uint16_t, std::uint16_t>> runs;
+    std::uint32_t low = 0;
+    while (low < CHUNK_SPAN) {
+      if (((words[low >> 6U] >> (low & 63U)) & 1U) == 0) {
+        ++low;
+        continue;
+      }
+      std::uint32_t start = low;
+      while (low < CHUNK_SPAN && ((words[low >> 6U] >> (low & 63U)) & 1U) != 0)
+        ++low;
+      runs.emplace_back(static_cast<std::uint16_t>(start),
+                        static_cast<std::uint16_t>(low - start - 1));
+    }
+
+    std::size_t runBytes = runs.size() * 4;
+    std::size_t currentBytes = chunk.cardinality <= ARRAY_LIMIT
+                                   ? std::size_t{chunk.cardinality} * 2
+                                   : WORDS_PER_CHUNK * 8;
+    if (runBytes < currentBytes) {
+      chunk.runs = std::move(runs);
+      release(chunk.array);
+      release(chunk.words);
+      chunk.kind = Kind::Run;
+    } else if (chunk.kind == Kind::Run) {
+      expandRuns(chunk);
+    }
+  }
+}
+
+std::size_t RoaringBitmap::memoryUsage() const {
+  std::size_t bytes = chunks.capacity() * sizeof(Chunk);
+  for (const Chunk &chunk : chunks) {
+    bytes += chunk.array.capacity() * sizeof(std::uint16_t);
+    bytes += chunk.words.capacity() * sizeof(std::uint64_t);
+    bytes += chunk.runs.capacity() * sizeof(chunk.runs[0]);
+  }
+  return bytes;
+}
+
+} // namespace ariel
@@ -0,0 +1,157 @@
+#ifndef ROARINGBITMAP_HPP
+#define ROARINGBITMAP_HPP
+
+#include "MagicalContainer.hpp"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace ariel {
+
+// Compressed integer set for dense ranges of values. The 32-bit value space is
+// split into 2^16 chunks keyed by the high 16 bits; each chunk stores its low
+// halves as a sorted array, a 65536-bit bitmap or a list of runs, whichever
+// fits the data.
+class RoaringBitmap {
+private:
+  enum class Kind { Array, Bitmap, Run };
+
+  struct Chunk {
+    std::uint16_t key = 0;
+    Kind kind = Kind::Array;
+    std::uint32_t cardinality = 0;
+    std::vector<std::uint16_t> array; // sorted low halves
+    std::vector<std::uint64_t> words; // 1024 words
+    std::vector<std::pair<std::uint16_t, std::uint16_t>> runs; // start, length-1
+    std::vector<std::uint64_t> primes; // prime mask of the range, if cached
+  };
+
+  std::vector<Chunk> chunks; // sorted by key
+  std::size_t count = 0;
+  std::size_t primeMasks = 0; // chunks with a cached prime mask
+
+  static constexpr std::uint32_t ARRAY_LIMIT = 4096;
+  static constexpr std::size_t WORDS_PER_CHUNK = 1024;
+  // Array chunks up to this size test their values for primality one by one,
+  // cheaper than sieving the chunk's whole range
+  static constexpr std::uint32_t PRIME_TEST_LIMIT = 32;
+  // Chunks with a cached prime mask, 8 KiB each; the rest sieve per traversal
+  static constexpr std::size_t MAX_PRIME_MASKS = 256;
+
+  // Values are biased so that unsigned order matches signed order
+  static std::uint32_t encode(int value) {
+    return static_cast<std::uint32_t>(value) ^ 0x80000000U;
+  }
+  static int decode(std::uint32_t bits) {
+    return static_cast<int>(bits ^ 0x80000000U);
+  }
+
+  Chunk *findChunk(std::uint16_t key);
+  const Chunk *findChunk(std::uint16_t key) const;
+  static bool chunkContains(const Chunk &chunk, std::uint16_t low);
+  static void toWords(const Chunk &chunk, std::uint64_t *out);
+  static void toArray(Chunk &chunk);
+  static void toBitmap(Chunk &chunk);
+  static void expandRuns(Chunk &chunk);
+  // Fills WORDS_PER_CHUNK words with the primes among the chunk's values
+  static void primeMask(std::uint16_t key, std::uint64_t *mask);
+  // Caches the chunk's prime mask once it is too large to test value by value
+  void cachePrimeMask(Chunk &chunk);
+
+  template <typename Fn>
+  static void decodeWords(std::uint32_t high, const std::uint64_t *words,
+                          Fn &fn) {
+    for (std::size_t i = 0; i < WORDS_PER_CHUNK; ++i) {
+      std::uint64_t word = words[i];
+      while (word != 0) {
+        auto bit = static_cast<std::uint32_t>(std::countr_zero(word));
+        fn(decode(high | static_cast<std::uint32_t>(i * 64) | bit));
+        word &= word - 1;
+      }
+    }
+  }
+
+public:
+  void addElement(int element);
+  void removeElement(int element);
+  bool contains(int element) const;
+  int size() const;
+
+  // Converts chunks to run containers where that is smaller
+  void runOptimize();
+
+  // Bytes used by the chunk payloads, not counting cached prime masks
+  std::size_t memoryUsage() const;
+
+  // Calls fn(value) for every element in ascending order
+  template <typename Fn> void forEachAscending(Fn fn) const {
+    for (const Chunk &chunk : chunks) {
+      std::uint32_t high = static_cast<std::uint32_t>(chunk.key) << 16U;
+      switch (chunk.kind) {
+      case Kind::Array:
+        for (std::uint16_t low : chunk.array) {
+          fn(decode(high | low));
+        }
+        break;
+      case Kind::Bitmap:
+        decodeWords(high, chunk.words.data(), fn);
+        break;
+      case Kind::Run:
+        for (const auto &run : chunk.runs) {
+          std::uint32_t last = std::uint32_t{run.first} + run.second;
+          for (std::uint32_t low = run.first; low <= last; ++low) {
+            fn(decode(high | low));
+          }
+        }
+        break;
+      }
+    }
+  }
+
+  // Calls fn(value) for every prime element in ascending order. Small array
+  // chunks test each value; larger chunks are ANDed with a prime bitmap of
+  // the same range, cached by addElement or, past the cache, sieved here.
+  template <typename Fn> void forEachPrime(Fn fn) const {
+    std::vector<std::uint64_t> scratch(WORDS_PER_CHUNK);
+    std::vector<std::uint64_t> sieved;
+    for (const Chunk &chunk : chunks) {
+      if (chunk.key < 0x8000) {
+        continue; // negative values
+      }
+      std::uint32_t high = static_cast<std::uint32_t>(chunk.key) << 16U;
+      if (chunk.kind == Kind::Array && chunk.cardinality <= PRIME_TEST_LIMIT) {
+        for (std::uint16_t low : chunk.array) {
+          if (isPrime(decode(high | low))) {
+            fn(decode(high | low));
+          }
+        }
+        continue;
+      }
+      const std::uint64_t *mask = chunk.primes.data();
+      if (chunk.primes.empty()) {
+        sieved.resize(WORDS_PER_CHUNK);
+        primeMask(chunk.key, sieved.data());
+        mask = sieved.data();
+      }
+      if (chunk.kind == Kind::Array) {
+        for (std::uint16_t low : chunk.array) {
+          if (((mask[low >> 6U] >> (low & 63U)) & 1U) != 0) {
+            fn(decode(high | low));
+          }
+        }
+        continue;
+      }
+      toWords(chunk, scratch.data());
+      for (std::size_t i = 0; i < WORDS_PER_CHUNK; ++i) {
+        scratch[i] &= mask[i];
+      }
+      decodeWords(high, scratch.data(), fn);
+    }
+  }
+};
+
+} // namespace ariel
+
+#endif /* ROARINGBITMAP_HPP */
@@ -0,0 +1,355 @@
+#include "ShardedMagicalContainer.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+namespace ariel {
+
+namespace {
+
+int elementAt(MagicalContainer &container, std::size_t index) {
+  return *MagicalContainer::AscendingIterator(container, index);
+}
+
+std::size_t sizeOf(MagicalContainer &container) {
+  return static_cast<std::size_t>(container.size());
+}
+
+} // namespace
+
+ShardedMagicalContainer::ShardedMagicalContainer(std::size_t shardCount,
+                                                 int low, int high) {
+  if (shardCount == 0 || low > high) {
+    throw std::runtime_error("Invalid shard layout");
+  }
+  for (std::size_t i = 0; i < shardCount; ++i) {
+    shards.push_back(std::make_unique<Shard>());
+  }
+  const std::int64_t span = std::int64_t{high} - low;
+  for (std::size_t i = 1; i < shardCount; ++i) {
+    boundaries.push_back(static_cast<int>(
+        low + span * static_cast<std::int64_t>(i) /
+                  static_cast<std::int64_t>(shardCount)));
+  }
+}
+
+std::size_t ShardedMagicalContainer::shardFor(int element) const {
+  return static_cast<std::size_t>(
+      std::upper_bound(boundaries.begin(), boundaries.end(), element) -
+      boundaries.begin());
+}
+
+bool ShardedMagicalContainer::isSkewed(std::size_t shardSize) const {
+  std::size_t count = total.load();
+  return shards.size() > 1 && count >= REBALANCE_MIN_SIZE &&
+         shardSize * shards.size() >= SKEW_FACTOR * count;
+}
+
+void ShardedMagicalContainer::addElement(int element) {
+  bool skewed = false;
+  {
+    std::shared_lock<std::shared_mutex> layout(layoutMutex);
+    Shard &target = *shards[shardFor(element)];
+    std::lock_guard<std::mutex> lock(target.mutex);
+    int before = target.container.size();
+    target.container.addElement(element);
+    if (target.container.size() != before) {
+      ++total;
+    }
+    skewed = isSkewed(sizeOf(target.container));
+  }
+  if (skewed) {
+    rebalance();
+  }
+}
+
+void ShardedMagicalContainer::removeElement(int element) {
+  std::shared_lock<std::shared_mutex> layout(layoutMutex);
+  Shard &target = *shards[shardFor(element)];
+  std::lock_guard<std::mutex> lock(target.mutex);
+  target.container.removeElement(element);
+  --total;
+}
+
+int ShardedMagicalContainer::size() const {
+  return static_cast<int>(total.load());
+}
+
+bool ShardedMagicalContainer::contains(int element) const {
+  std::shared_lock<std::shared_mutex> layout(layoutMutex);
+  const Shard &target = *shards[shardFor(element)];
+  std::lock_guard<std::mutex> lock(target.mutex);
+  return target.container.contains(element);
+}
+
+std::size_t ShardedMagicalContainer::shardCount() const {
+  return shards.size();
+}
+
+int ShardedMagicalContainer::shardSize(std::size_t shard) const {
+  std::lock_guard<std::mutex> lock(shards.at(shard)->mutex);
+  return shards[shard]->container.size();
+}
+
+bool ShardedMagicalContainer::rebalance(bool force) {
+  std::unique_lock<std::shared_mutex> layout(layoutMutex);
+  if (!force && std::none_of(shards.begin(), shards.end(),
+                             [this](const std::unique_ptr<Shard> &shard) {
+                               return isSkewed(sizeOf(shard->container));
+                             })) {
+    return false;
+  }
+
+  std::vector<int> all;
+  all.reserve(total.load());
+  for (const std::unique_ptr<Shard> &shard : shards) {
+    MagicalContainer::AscendingIterator it(shard->container);
+    for (auto i = it.begin(); i != it.end(); ++i) {
+      all.push_back(*i);
+    }
+  }
+  if (all.empty())
+    return false;
+
+  // New boundaries at the quantiles of the current data
+  const std::size_t count = shards.size();
+  for (std::size_t i = 1; i < count; ++i) {
+    boundaries[i - 1] = all[i * all.size() / count];
+  }
+  // Each shard's range is a contiguous slice of all; built in bulk
+  auto first = all.begin();
+  for (std::size_t i = 0; i < count; ++i) {
+    auto last = i + 1 < count
+                    ? std::lower_bound(first, all.end(), boundaries[i])
+                    : all.end();
+    shards[i]->container = MagicalContainer::buildParallel(
+        std::span<const int>(all.data() + (first - all.begin()),
+                             static_cast<std::size_t>(last - first)));
+    first = last;
+  }
+  return true;
+}
+
+// AscendingIterator
+ShardedMagicalContainer::AscendingIterator::AscendingIterator(
+    ShardedMagicalContainer &cont)
+    : container(&cont), shard(0), index(0) {
+  skipEmpty();
+}
+
+void ShardedMagicalContainer::AscendingIterator::skipEmpty() {
+  while (shard < container->shards.size() &&
+         index >= sizeOf(container->shards[shard]->container)) {
+    ++shard;
+    index = 0;
+  }
+}
+
+bool ShardedMagicalContainer::AscendingIterator::operator==(
+    const AscendingIterator &other) const {
+  return shard == other.shard && index == other.index;
+}
+
+bool ShardedMagicalContainer::AscendingIterator::operator!=(
+    const AscendingIterator &other) const {
+  return !(*this == other);
+}
+
+bool ShardedMagicalContainer::AscendingIterator::operator>(
+    const AscendingIterator &other) const {
+  return other < *this;
+}
+
+bool ShardedMagicalContainer::AscendingIterator::operator<(
+    const AscendingIterator &other) const {
+  return shard < other.shard || (shard == other.shard && index < other.index);
+}
+
+int ShardedMagicalContainer::AscendingIterator::operator*() const {
+  if (shard >= container->shards.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  return elementAt(container->shards[shard]->container, index);
+}
+
+ShardedMagicalContainer::AscendingIterator &
+ShardedMagicalContainer::AscendingIterator::operator++() {
+  if (shard >= container->shards.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++index;
+  skipEmpty();
+  return *this;
+}
+
+ShardedMagicalContainer::AscendingIterator
+ShardedMagicalContainer::AscendingIterator::begin() const {
+  return AscendingIterator(*container);
+}
+
+ShardedMagicalContainer::AscendingIterator
+ShardedMagicalContainer::AscendingIterator::end() const {
+  AscendingIterator last(*container);
+  last.shard = container->shards.size();
+  last.index = 0;
+  return last;
+}
+
+// SideCrossIterator: the front cursor walks the shards upwards and the back
+// cursor downwards, meeting in the middle
+ShardedMagicalContainer::SideCrossIterator::SideCrossIterator(
+    ShardedMagicalContainer &cont)
+    : container(&cont), position(0), frontShard(0), frontIndex(0),
+      backShard(cont.shards.size()),
+      backIndex(sizeOf(cont.shards.back()->container)) {
+  settleFront();
+  settleBack();
+}
+
+void ShardedMagicalContainer::SideCrossIterator::settleFront() {
+  while (frontShard < container->shards.size() &&
+         frontIndex >= sizeOf(container->shards[frontShard]->container)) {
+    ++frontShard;
+    frontIndex = 0;
+  }
+}
+
+void ShardedMagicalContainer::SideCrossIterator::settleBack() {
+  while (backShard > 0 && backIndex == 0) {
+    --backShard;
+    backIndex = backShard > 0
+                    ? sizeOf(container->shards[backShard - 1]->container)
+                    : 0;
+  }
+}
+
+bool ShardedMagicalContainer::SideCrossIterator::operator==(
+    const SideCrossIterator &other) const {
+  return position == other.position;
+}
+
+bool ShardedMagicalContainer::SideCrossIterator::operator!=(
+    const SideCrossIterator &other) const {
+  return !(*this == other);
+}
+
+bool ShardedMagicalContainer::SideCrossIterator::operator>(
+    const SideCrossIterator &other) const {
+  return position > other.position;
+}
+
+bool ShardedMagicalContainer::SideCrossIterator::operator<(
+    const SideCrossIterator &other) const {
+  return position < other.position;
+}
+
+int ShardedMagicalContainer::SideCrossIterator::operator*() const {
+  if (position >= static_cast<std::size_t>(container->size())) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  if (position % 2 == 0) {
+    return elementAt(container->shards[frontShard]->container, frontIndex);
+  }
+  return elementAt(container->shards[backShard - 1]->container,
+                   backIndex - 1);
+}
+
+ShardedMagicalContainer::SideCrossIterator &
+ShardedMagicalContainer::SideCrossIterator::operator++() {
+  if (position >= static_cast<std::size_t>(container->size())) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  if (position % 2 == 0) {
+    ++frontIndex;
+    settleFront();
+  } else {
+    --backIndex;
+    settleBack();
+  }
+  ++position;
+  return *this;
+}
+
+ShardedMagicalContainer::SideCrossIterator
+ShardedMagicalContainer::SideCrossIterator::begin() const {
+  return SideCrossIterator(*container);
+}
+
+ShardedMagicalContainer::SideCrossIterator
+ShardedMagicalContainer::SideCrossIterator::end() const {
+  SideCrossIterator last(*container);
+  last.position = static_cast<std::size_t>(container->size());
+  return last;
+}
+
+// PrimeIterator
+ShardedMagicalContainer::PrimeIterator::PrimeIterator(
+    ShardedMagicalContainer &cont)
+    : container(&cont), shard(0), index(0) {
+  skipEmpty();
+}
+
+void ShardedMagicalContainer::PrimeIterator::skipEmpty() {
+  while (shard < container->shards.size()) {
+    MagicalContainer &current = container->shards[shard]->container;
+    MagicalContainer::PrimeIterator primes(current, index);
+    if (primes != primes.end())
+      return;
+    ++shard;
+    index = 0;
+  }
+}
+
+bool ShardedMagicalContainer::PrimeIterator::operator==(
+    const PrimeIterator &other) const {
+  return shard == other.shard && index == other.index;
+}
+
+bool ShardedMagicalContainer::PrimeIterator::operator!=(
+    const PrimeIterator &other) const {
+  return !(*this == other);
+}
+
+bool ShardedMagicalContainer::PrimeIterator::operator>(
+    const PrimeIterator &other) const {
+  return other < *this;
+}
+
+bool ShardedMagicalContainer::PrimeIterator::operator<(
+    const PrimeIterator &other) const {
+  return shard < other.shard || (shard == other.shard && index < other.index);
+}
+
+int ShardedMagicalContainer::PrimeIterator::operator*() const {
+  if (shard >= container->shards.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  return *MagicalContainer::PrimeIterator(container->shards[shard]->container,
+                                          index);
+}
+
+ShardedMagicalContainer::PrimeIterator &
+ShardedMagicalContainer::PrimeIterator::operator++() {
+  if (shard >= container->shards.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++index;
+  skipEmpty();
+  return *this;
+}
+
+ShardedMagicalContainer::PrimeIterator
+ShardedMagicalContainer::PrimeIterator::begin() const {
+  return PrimeIterator(*container);
+}
+
+ShardedMagicalContainer::PrimeIterator
+ShardedMagicalContainer::PrimeIterator::end() const {
+  PrimeIterator last(*container);
+  last.shard = container->shards.size();
+  last.index = 0;
+  return last;
+}
+
+} // namespace ariel
@@ -0,0 +1,151 @@
+#ifndef SHARDEDMAGICALCONTAINER_HPP
+#define SHARDEDMAGICALCONTAINER_HPP
+
+#include "MagicalContainer.hpp"
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+namespace ariel {
+
+// MagicalContainer split into value-range shards, each with its own lock, so
+// writers touching different ranges do not contend. Shard i holds the values
+// in [boundaries[i-1], boundaries[i]). When one shard grows well past the
+// average the boundaries are recomputed from the data.
+//
+// Iterators chain the shards and, like MagicalContainer's, must not be used
+// while writers are active.
+class ShardedMagicalContainer {
+private:
+  struct Shard {
+    mutable std::mutex mutex; // const reads lock it too
+    MagicalContainer container;
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::vector<int> boundaries;
+  mutable std::shared_mutex layoutMutex; // exclusive while rebalancing
+  std::atomic<std::size_t> total{0};
+
+  // A shard is skewed once it holds this many times the average
+  static constexpr std::size_t SKEW_FACTOR = 2;
+  static constexpr std::size_t REBALANCE_MIN_SIZE = 1024;
+
+  std::size_t shardFor(int element) const;
+  bool isSkewed(std::size_t shardSize) const;
+
+public:
+  explicit ShardedMagicalContainer(std::size_t shardCount, int low = INT_MIN,
+                                   int high = INT_MAX);
+
+  void addElement(int element);
+  void removeElement(int element);
+  int size() const;
+  bool contains(int element) const;
+
+  std::size_t shardCount() const;
+  int shardSize(std::size_t shard) const;
+
+  // Moves the boundaries to the data's quantiles if a shard is skewed;
+  // returns whether anything moved
+  bool rebalance(bool force = false);
+
+  class AscendingIterator {
+  private:
+    ShardedMagicalContainer *container;
+    std::size_t shard;
+    std::size_t index;
+
+    void skipEmpty();
+
+  public:
+    // Constructor
+    AscendingIterator(ShardedMagicalContainer &cont);
+
+    // Comparison operators
+    bool operator==(const AscendingIterator &other) const;
+    bool operator!=(const AscendingIterator &other) const;
+    bool operator>(const AscendingIterator &other) const;
+    bool operator<(const AscendingIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    AscendingIterator &operator++();
+
+    // Iterator begin and end functions
+    AscendingIterator begin() const;
+    AscendingIterator end() const;
+  };
+
+  class SideCrossIterator {
+  private:
+    ShardedMagicalContainer *container;
+    std::size_t position;
+    std::size_t frontShard;
+    std::size_t frontIndex;
+    std::size_t backShard; // one past the shard holding the back element
+    std::size_t backIndex; // one past the back element in that shard
+
+    void settleFront();
+    void settleBack();
+
+  public:
+    // Constructor
+    SideCrossIterator(ShardedMagicalContainer &cont);
+
+    // Comparison operators
+    bool operator==(const SideCrossIterator &other) const;
+    bool operator!=(const SideCrossIterator &other) const;
+    bool operator>(const SideCrossIterator &other) const;
+    bool operator<(const SideCrossIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    SideCrossIterator &operator++();
+
+    // Iterator begin and end functions
+    SideCrossIterator begin() const;
+    SideCrossIterator end() const;
+  };
+
+  class PrimeIterator {
+  private:
+    ShardedMagicalContainer *container;
+    std::size_t shard;
+    std::size_t index;
+
+    void skipEmpty();
+
+  public:
+    // Constructor
+    PrimeIterator(ShardedMagicalContainer &cont);
+
+    // Comparison operators
+    bool operator==(const PrimeIterator &other) const;
+    bool operator!=(const PrimeIterator &other) const;
+    bool operator>(const PrimeIterator &other) const;
+    bool operator<(const PrimeIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    PrimeIterator &operator++();
+
+    // Iterator begin and end functions
+    PrimeIterator begin() const;
+    PrimeIterator end() const;
+  };
+};
+
+} // namespace ariel
+
+#endif /* SHARDEDMAGICALCONTAINER_HPP */
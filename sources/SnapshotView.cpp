@@ -0,0 +1,335 @@
+#include "SnapshotView.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace ariel {
+
+namespace {
+
+void ensureWritable(std::shared_ptr<SnapshotView::Table> &table) {
+  if (table->frozen) {
+    table = std::make_shared<SnapshotView::Table>(*table);
+    table->frozen = false;
+    ++table->generation;
+  }
+}
+
+void ensureWritable(const SnapshotView::Table &table,
+                    std::shared_ptr<SnapshotView::Chunk> &chunk) {
+  if (chunk->generation != table.generation) {
+    chunk = std::make_shared<SnapshotView::Chunk>(*chunk);
+    chunk->generation = table.generation;
+  }
+}
+
+} // namespace
+
+std::shared_ptr<SnapshotView::Table>
+SnapshotView::build(const std::vector<int> &sorted,
+                    const std::vector<int *> &primes) {
+  auto table = std::make_shared<Table>();
+  std::size_t p = 0;
+  for (std::size_t begin = 0; begin < sorted.size(); begin += CHUNK_SIZE) {
+    std::size_t end = std::min(sorted.size(), begin + CHUNK_SIZE);
+    auto chunk = std::make_shared<Chunk>();
+    chunk->values.assign(sorted.begin() + static_cast<std::ptrdiff_t>(begin),
+                         sorted.begin() + static_cast<std::ptrdiff_t>(end));
+    for (; p < primes.size() && *primes[p] <= sorted[end - 1]; ++p) {
+      chunk->primes.push_back(*primes[p]);
+    }
+    table->chunks.push_back(std::move(chunk));
+  }
+  table->count = sorted.size();
+  table->primeCount = primes.size();
+  return table;
+}
+
+void SnapshotView::freeze(Table &table) { table.frozen = true; }
+
+std::size_t SnapshotView::chunkFor(const Table &table, int element) {
+  auto found = std::lower_bound(
+      table.chunks.begin(), table.chunks.end() - 1, element,
+      [](const std::shared_ptr<Chunk> &chunk, int value) {
+        return chunk->values.back() < value;
+      });
+  return static_cast<std::size_t>(found - table.chunks.begin());
+}
+
+void SnapshotView::insert(std::shared_ptr<Table> &table, int element,
+                          bool prime) {
+  ensureWritable(table);
+  std::size_t index = 0;
+  if (table->chunks.empty()) {
+    table->chunks.push_back(std::make_shared<Chunk>());
+    table->chunks.back()->generation = table->generation;
+  } else {
+    index = chunkFor(*table, element);
+  }
+  std::shared_ptr<Chunk> &chunk = table->chunks[index];
+  ensureWritable(*table, chunk);
+
+  std::vector<int> &values = chunk->values;
+  values.insert(std::lower_bound(values.begin(), values.end(), element),
+                element);
+  if (prime) {
+    std::vector<int> &primes = chunk->primes;
+    primes.insert(std::lower_bound(primes.begin(), primes.end(), element),
+                  element);
+    ++table->primeCount;
+  }
+  ++table->count;
+
+  if (values.size() >= 2 * CHUNK_SIZE) {
+    auto upper = std::make_shared<Chunk>();
+    upper->generation = table->generation;
+    const auto middle = values.begin() + static_cast<std::ptrdiff_t>(CHUNK_SIZE);
+    const auto primesMiddle =
+        std::lower_bound(chunk->primes.begin(), chunk->primes.end(), *middle);
+    upper->values.assign(middle, values.end());
+    upper->primes.assign(primesMiddle, chunk->primes.end());
+    values.erase(middle, values.end());
+    chunk->primes.erase(primesMiddle, chunk->primes.end());
+    table->chunks.insert(
+        table->chunks.begin() + static_cast<std::ptrdiff_t>(index + 1),
+        std::move(upper));
+  }
+}
+
+void SnapshotView::erase(std::shared_ptr<Table> &table, int element) {
+  ensureWritable(table);
+  std::size_t index = chunkFor(*table, element);
+  std::shared_ptr<Chunk> &chunk = table->chunks[index];
+  ensureWritable(*table, chunk);
+
+  std::vector<int> &values = chunk->values;
+  values.erase(std::lower_bound(values.begin(), values.end(), element));
+  std::vector<int> &primes = chunk->primes;
+  auto prime = std::lower_bound(primes.begin(), primes.end(), element);
+  if (prime != primes.end() && *prime == element) {
+    primes.erase(prime);
+    --table->primeCount;
+  }
+  --table->count;
+
+  if (values.empty()) {
+    table->chunks.erase(table->chunks.begin() +
+                        static_cast<std::ptrdiff_t>(index));
+  }
+}
+
+SnapshotView::SnapshotView() : table(std::make_shared<const Table>()) {}
+
+SnapshotView::SnapshotView(std::shared_ptr<const Table> table)
+    : table(std::move(table)) {}
+
+int SnapshotView::size() const { return static_cast<int>(table->count); }
+
+std::size_t SnapshotView::primeCount() const { return table->primeCount; }
+
+bool SnapshotView::contains(int element) const {
+  if (table->chunks.empty()) {
+    return false;
+  }
+  const std::vector<int> &values =
+      table->chunks[chunkFor(*table, element)]->values;
+  return std::binary_search(values.begin(), values.end(), element);
+}
+
+// AscendingIterator: (chunk, offset) of the current value; end is
+// (chunks.size(), 0)
+SnapshotView::AscendingIterator::AscendingIterator(const SnapshotView &view)
+    : table(view.table.get()), chunk(0), offset(0) {}
+
+bool SnapshotView::AscendingIterator::operator==(
+    const AscendingIterator &other) const {
+  return chunk == other.chunk && offset == other.offset;
+}
+
+bool SnapshotView::AscendingIterator::operator!=(
+    const AscendingIterator &other) const {
+  return !(*this == other);
+}
+
+bool SnapshotView::AscendingIterator::operator>(
+    const AscendingIterator &other) const {
+  return other < *this;
+}
+
+bool SnapshotView::AscendingIterator::operator<(
+    const AscendingIterator &other) const {
+  return chunk < other.chunk || (chunk == other.chunk && offset < other.offset);
+}
+
+int SnapshotView::AscendingIterator::operator*() const {
+  if (chunk >= table->chunks.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  return table->chunks[chunk]->values[offset];
+}
+
+SnapshotView::AscendingIterator &
+SnapshotView::AscendingIterator::operator++() {
+  if (chunk >= table->chunks.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  if (++offset == table->chunks[chunk]->values.size()) {
+    ++chunk;
+    offset = 0;
+  }
+  return *this;
+}
+
+SnapshotView::AscendingIterator SnapshotView::AscendingIterator::begin() const {
+  AscendingIterator first(*this);
+  first.chunk = 0;
+  first.offset = 0;
+  return first;
+}
+
+SnapshotView::AscendingIterator SnapshotView::AscendingIterator::end() const {
+  AscendingIterator last(*this);
+  last.chunk = table->chunks.size();
+  last.offset = 0;
+  return last;
+}
+
+// SideCrossIterator: one cursor walks up from the front and one down from the
+// back; even positions read the front cursor, odd ones the back cursor
+SnapshotView::SideCrossIterator::SideCrossIterator(const SnapshotView &view)
+    : table(view.table.get()), position(0), frontChunk(0), frontOffset(0),
+      backChunk(0), backOffset(0) {
+  if (!table->chunks.empty()) {
+    backChunk = table->chunks.size() - 1;
+    backOffset = table->chunks[backChunk]->values.size() - 1;
+  }
+}
+
+bool SnapshotView::SideCrossIterator::operator==(
+    const SideCrossIterator &other) const {
+  return position == other.position;
+}
+
+bool SnapshotView::SideCrossIterator::operator!=(
+    const SideCrossIterator &other) const {
+  return !(*this == other);
+}
+
+bool SnapshotView::SideCrossIterator::operator>(
+    const SideCrossIterator &other) const {
+  return position > other.position;
+}
+
+bool SnapshotView::SideCrossIterator::operator<(
+    const SideCrossIterator &other) const {
+  return position < other.position;
+}
+
+int SnapshotView::SideCrossIterator::operator*() const {
+  if (position >= table->count) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  if (position % 2 == 0)
+    return table->chunks[frontChunk]->values[frontOffset];
+  else
+    return table->chunks[backChunk]->values[backOffset];
+}
+
+SnapshotView::SideCrossIterator &
+SnapshotView::SideCrossIterator::operator++() {
+  if (position >= table->count) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  if (position % 2 == 0) {
+    if (++frontOffset == table->chunks[frontChunk]->values.size()) {
+      ++frontChunk;
+      frontOffset = 0;
+    }
+  } else if (backOffset-- == 0) {
+    --backChunk;
+    backOffset = table->chunks[backChunk]->values.size() - 1;
+  }
+  ++position;
+  return *this;
+}
+
+SnapshotView::SideCrossIterator SnapshotView::SideCrossIterator::begin() const {
+  SideCrossIterator first(*this);
+  first.position = 0;
+  first.frontChunk = 0;
+  first.frontOffset = 0;
+  if (!table->chunks.empty()) {
+    first.backChunk = table->chunks.size() - 1;
+    first.backOffset = table->chunks[first.backChunk]->values.size() - 1;
+  }
+  return first;
+}
+
+SnapshotView::SideCrossIterator SnapshotView::SideCrossIterator::end() const {
+  SideCrossIterator last(*this);
+  last.position = table->count;
+  return last;
+}
+
+// PrimeIterator: as AscendingIterator, over each chunk's primes
+SnapshotView::PrimeIterator::PrimeIterator(const SnapshotView &view)
+    : table(view.table.get()), chunk(0), offset(0) {
+  settle();
+}
+
+void SnapshotView::PrimeIterator::settle() {
+  while (chunk < table->chunks.size() &&
+         offset == table->chunks[chunk]->primes.size()) {
+    ++chunk;
+    offset = 0;
+  }
+}
+
+bool SnapshotView::PrimeIterator::operator==(const PrimeIterator &other) const {
+  return chunk == other.chunk && offset == other.offset;
+}
+
+bool SnapshotView::PrimeIterator::operator!=(const PrimeIterator &other) const {
+  return !(*this == other);
+}
+
+bool SnapshotView::PrimeIterator::operator>(const PrimeIterator &other) const {
+  return other < *this;
+}
+
+bool SnapshotView::PrimeIterator::operator<(const PrimeIterator &other) const {
+  return chunk < other.chunk || (chunk == other.chunk && offset < other.offset);
+}
+
+int SnapshotView::PrimeIterator::operator*() const {
+  if (chunk >= table->chunks.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  return table->chunks[chunk]->primes[offset];
+}
+
+SnapshotView::PrimeIterator &SnapshotView::PrimeIterator::operator++() {
+  if (chunk >= table->chunks.size()) {
+    throw std::runtime_error("Iterator out of range");
+  }
+  ++offset;
+  settle();
+  return *this;
+}
+
+SnapshotView::PrimeIterator SnapshotView::PrimeIterator::begin() const {
+  PrimeIterator first(*this);
+  first.chunk = 0;
+  first.offset = 0;
+  first.settle();
+  return first;
+}
+
+SnapshotView::PrimeIterator SnapshotView::PrimeIterator::end() const {
+  PrimeIterator last(*this);
+  last.chunk = table->chunks.size();
+  last.offset = 0;
+  return last;
+}
+
+} // namespace ariel
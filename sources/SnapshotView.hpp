@@ -0,0 +1,149 @@
+#ifndef SNAPSHOTVIEW_HPP
+#define SNAPSHOTVIEW_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ariel {
+
+// Point-in-time view of a MagicalContainer, from MagicalContainer::snapshot().
+// The container keeps a chunked mirror of its elements; a view shares the
+// mirror's table and chunks. Once a table is handed out it is frozen: the
+// next change copies it, and then copies each chunk it touches once. Chunks
+// are never written after they may have been shared, whatever the reference
+// counts say, so a view can be read from any thread without locks.
+class SnapshotView {
+public:
+  // A chunk is split once it reaches twice this many values
+  static constexpr std::size_t CHUNK_SIZE = 1024;
+
+  struct Chunk {
+    std::vector<int> values; // sorted
+    std::vector<int> primes; // the prime values, sorted
+    std::uint64_t generation = 0; // of the only table that may change it
+  };
+
+  struct Table {
+    std::vector<std::shared_ptr<Chunk>> chunks; // none empty, in value order
+    std::size_t count = 0;
+    std::size_t primeCount = 0;
+    std::uint64_t generation = 0;
+    bool frozen = false; // shared: copied before the next change
+  };
+
+  // Writer side, used by MagicalContainer. freeze marks a table that is about
+  // to be shared; insert and erase then copy it, and copy any chunk from an
+  // older generation before changing it.
+  static std::shared_ptr<Table> build(const std::vector<int> &sorted,
+                                      const std::vector<int *> &primes);
+  static void freeze(Table &table);
+  static void insert(std::shared_ptr<Table> &table, int element, bool prime);
+  static void erase(std::shared_ptr<Table> &table, int element);
+
+private:
+  std::shared_ptr<const Table> table;
+
+  // Chunk that holds element, or would hold it; chunks must not be empty
+  static std::size_t chunkFor(const Table &table, int element);
+
+public:
+  SnapshotView();
+  explicit SnapshotView(std::shared_ptr<const Table> table);
+
+  int size() const;
+  std::size_t primeCount() const;
+  bool contains(int element) const;
+
+  class AscendingIterator {
+  private:
+    const Table *table;
+    std::size_t chunk;
+    std::size_t offset;
+
+  public:
+    // Constructor
+    AscendingIterator(const SnapshotView &view);
+
+    // Comparison operators
+    bool operator==(const AscendingIterator &other) const;
+    bool operator!=(const AscendingIterator &other) const;
+    bool operator>(const AscendingIterator &other) const;
+    bool operator<(const AscendingIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    AscendingIterator &operator++();
+
+    // Iterator begin and end functions
+    AscendingIterator begin() const;
+    AscendingIterator end() const;
+  };
+
+  class SideCrossIterator {
+  private:
+    const Table *table;
+    std::size_t position; // elements visited so far
+    std::size_t frontChunk;
+    std::size_t frontOffset;
+    std::size_t backChunk;
+    std::size_t backOffset;
+
+  public:
+    // Constructor
+    SideCrossIterator(const SnapshotView &view);
+
+    // Comparison operators
+    bool operator==(const SideCrossIterator &other) const;
+    bool operator!=(const SideCrossIterator &other) const;
+    bool operator>(const SideCrossIterator &other) const;
+    bool operator<(const SideCrossIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    SideCrossIterator &operator++();
+
+    // Iterator begin and end functions
+    SideCrossIterator begin() const;
+    SideCrossIterator end() const;
+  };
+
+  class PrimeIterator {
+  private:
+    const Table *table;
+    std::size_t chunk;
+    std::size_t offset;
+
+    // Moves past chunks without primes
+    void settle();
+
+  public:
+    // Constructor
+    PrimeIterator(const SnapshotView &view);
+
+    // Comparison operators
+    bool operator==(const PrimeIterator &other) const;
+    bool operator!=(const PrimeIterator &other) const;
+    bool operator>(const PrimeIterator &other) const;
+    bool operator<(const PrimeIterator &other) const;
+
+    // Dereference operator
+    int operator*() const;
+
+    // Increment operator
+    PrimeIterator &operator++();
+
+    // Iterator begin and end functions
+    PrimeIterator begin() const;
+    PrimeIterator end() const;
+  };
+};
+
+} // namespace ariel
+
+#endif /* SNAPSHOTVIEW_HPP */